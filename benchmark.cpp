@@ -0,0 +1,17 @@
+#include "benchmark.hpp"
+#include <iostream>
+#include <exception>
+
+int main(int argc, char** argv) {
+    Benchmark::Options options;
+    try {
+        options = Benchmark::parse_options(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    Benchmark benchmark(options);
+    benchmark.print(benchmark.run(), std::cout);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,408 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include "library.hpp"
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <stdexcept>
+
+// Benchmark suite over a synthetic corpus. Book texts draw words from a
+// Zipf distribution over a fixed vocabulary, so a few words appear in nearly
+// every book and most appear in few. Everything is derived from --seed:
+// the same options give the same corpus and the same query mix.
+//
+//   benchmark [--books N] [--length N] [--vocab N] [--skew S] [--queries N]
+//             [--seed N] [--threads N] [--format json|csv]
+//
+// benchmark.cpp only parses the command line; main.cpp runs the same suite
+// on a tiny corpus as a smoke test.
+class Benchmark {
+public:
+    struct Options {
+        int books = 200;
+        int length = 5000;
+        int vocab = 20000;
+        double skew = 1.0;
+        int queries = 20000;
+        uint64_t seed = 42;
+        int threads = 0;
+        std::string format = "json";
+    };
+
+    struct Row {
+        std::string suite;
+        std::string target;
+        std::string op;
+        size_t count;
+        double total_s;
+        double ops_per_s;
+        bool has_latency;
+        double p50_ns;
+        double p99_ns;
+        double p999_ns;
+    };
+
+    static Options parse_options(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            std::string flag = argv[i];
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + flag);
+            }
+            std::string value = argv[++i];
+            if (flag == "--books") {
+                options.books = std::stoi(value);
+            } else if (flag == "--length") {
+                options.length = std::stoi(value);
+            } else if (flag == "--vocab") {
+                options.vocab = std::stoi(value);
+            } else if (flag == "--skew") {
+                options.skew = std::stod(value);
+            } else if (flag == "--queries") {
+                options.queries = std::stoi(value);
+            } else if (flag == "--seed") {
+                options.seed = std::stoull(value);
+            } else if (flag == "--threads") {
+                options.threads = std::stoi(value);
+            } else if (flag == "--format") {
+                options.format = value;
+            } else {
+                throw std::invalid_argument("Unknown option " + flag);
+            }
+        }
+        if (options.books <= 0 || options.length <= 0 || options.vocab <= 0 || options.queries <= 0) {
+            throw std::invalid_argument("Counts must be positive");
+        }
+        if (options.format != "json" && options.format != "csv") {
+            throw std::invalid_argument("Format must be json or csv");
+        }
+        return options;
+    }
+
+    explicit Benchmark(const Options& options_) : options(options_), corpus(make_corpus(options_)), checksum(0) {}
+
+    std::vector<Row> run() {
+        std::vector<Row> rows;
+        bench_libraries(rows);
+        bench_tables(rows);
+        return rows;
+    }
+
+    void print(const std::vector<Row>& rows, std::ostream& out) const {
+        if (options.format == "json") {
+            print_json(rows, out);
+        } else {
+            print_csv(rows, out);
+        }
+    }
+
+private:
+    // splitmix64: the standard distributions are implementation-defined, so
+    // the corpus is generated from raw 64-bit outputs only.
+    class Rng {
+    private:
+        uint64_t state;
+
+    public:
+        explicit Rng(uint64_t seed) : state(seed) {}
+
+        uint64_t next() {
+            uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+
+        double uniform() {
+            return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        size_t below(size_t n) {
+            return static_cast<size_t>(next() % n);
+        }
+    };
+
+    // Rank r (0-based) is drawn with probability proportional to
+    // 1 / (r + 1)^skew.
+    class Zipf {
+    private:
+        std::vector<double> cdf;
+
+    public:
+        Zipf(int n, double skew) : cdf(n) {
+            double sum = 0;
+            for (int r = 0; r < n; ++r) {
+                sum += 1.0 / std::pow(r + 1, skew);
+                cdf[r] = sum;
+            }
+            for (double& c : cdf) {
+                c /= sum;
+            }
+        }
+
+        int sample(Rng& rng) const {
+            auto it = std::lower_bound(cdf.begin(), cdf.end(), rng.uniform());
+            return it == cdf.end() ? static_cast<int>(cdf.size()) - 1 : static_cast<int>(it - cdf.begin());
+        }
+    };
+
+    struct Corpus {
+        std::vector<std::string> vocabulary;
+        std::vector<std::string> titles;
+        std::vector<std::vector<std::string>> texts;
+        size_t total_words = 0;
+    };
+
+    struct Count {
+        int value;
+
+        std::string to_string() const {
+            return std::to_string(value);
+        }
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    Options options;
+    Corpus corpus;
+    // Results feed this so the optimizer cannot drop the measured calls.
+    uint64_t checksum;
+
+    // Vocabulary words are lowercase base-26 spellings of their rank.
+    static std::string word_for(int rank) {
+        std::string word;
+        do {
+            word += static_cast<char>('a' + rank % 26);
+            rank /= 26;
+        } while (rank > 0);
+        return word;
+    }
+
+    static Corpus make_corpus(const Options& options) {
+        Corpus corpus;
+        for (int r = 0; r < options.vocab; ++r) {
+            corpus.vocabulary.push_back(word_for(r));
+        }
+        Zipf zipf(options.vocab, options.skew);
+        Rng rng(options.seed);
+        for (int b = 0; b < options.books; ++b) {
+            corpus.titles.push_back("book" + std::to_string(b));
+            std::vector<std::string> text;
+            text.reserve(options.length);
+            for (int i = 0; i < options.length; ++i) {
+                text.push_back(corpus.vocabulary[zipf.sample(rng)]);
+            }
+            corpus.total_words += text.size();
+            corpus.texts.push_back(std::move(text));
+        }
+        return corpus;
+    }
+
+    static double seconds_since(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Nearest-rank percentile of sorted samples.
+    static double percentile(const std::vector<double>& sorted, double p) {
+        if (sorted.empty()) return 0;
+        size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+        return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+    }
+
+    static Row throughput_row(const std::string& suite, const std::string& target, const std::string& op, size_t count,
+                              double total_s) {
+        return {suite, target, op, count, total_s, count / total_s, false, 0, 0, 0};
+    }
+
+    // Times each call on its own and reports the latency distribution.
+    static Row latency_row(const std::string& suite, const std::string& target, const std::string& op, size_t count,
+                           const std::function<void(size_t)>& call) {
+        std::vector<double> samples;
+        samples.reserve(count);
+        auto start = Clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            auto t0 = Clock::now();
+            call(i);
+            samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - t0).count());
+        }
+        double total_s = seconds_since(start);
+        std::sort(samples.begin(), samples.end());
+        return {suite, target, op, count, total_s, count / total_s, true,
+                percentile(samples, 0.50), percentile(samples, 0.99), percentile(samples, 0.999)};
+    }
+
+    void query_library(const std::string& target, DigitalLibrary& lib, std::vector<Row>& rows) {
+        Rng rng(options.seed + 1);
+        Zipf zipf(options.vocab, options.skew);
+        std::vector<size_t> books(options.queries);
+        std::vector<int> words(options.queries);
+        for (int i = 0; i < options.queries; ++i) {
+            books[i] = rng.below(corpus.titles.size());
+            words[i] = zipf.sample(rng);
+        }
+        rows.push_back(latency_row("library", target, "distinct_words", options.queries, [&](size_t i) {
+            checksum += lib.distinct_words(corpus.titles[books[i]]).size();
+        }));
+        rows.push_back(latency_row("library", target, "count_distinct_words", options.queries, [&](size_t i) {
+            checksum += lib.count_distinct_words(corpus.titles[books[i]]);
+        }));
+        rows.push_back(latency_row("library", target, "search_keyword", options.queries, [&](size_t i) {
+            checksum += lib.search_keyword(corpus.vocabulary[words[i]]).size();
+        }));
+    }
+
+    void bench_libraries(std::vector<Row>& rows) {
+        {
+            auto start = Clock::now();
+            MuskLibrary lib(corpus.titles, corpus.texts, options.threads);
+            rows.push_back(throughput_row("library", "Musk", "ingest_words", corpus.total_words, seconds_since(start)));
+            query_library("Musk", lib, rows);
+        }
+
+        std::vector<std::pair<std::string, std::vector<int>>> variants = {
+            {"Jobs", {10, 29}}, {"Gates", {10, 37}}, {"Bezos", {10, 37, 7, 13}}};
+        for (const auto& [name, params] : variants) {
+            std::string target = name == "Jobs" ? "JGB-Chain" : name == "Gates" ? "JGB-Linear" : "JGB-Double";
+            {
+                JGBLibrary lib(name, params, HashFunction::Polynomial, options.threads);
+                auto start = Clock::now();
+                for (size_t i = 0; i < corpus.titles.size(); ++i) {
+                    lib.add_book(corpus.titles[i], corpus.texts[i]);
+                }
+                rows.push_back(throughput_row("library", target, "ingest_words", corpus.total_words, seconds_since(start)));
+                query_library(target, lib, rows);
+            }
+            {
+                JGBLibrary lib(name, params, HashFunction::Polynomial, options.threads);
+                auto start = Clock::now();
+                lib.add_books(corpus.titles, corpus.texts);
+                rows.push_back(throughput_row("library", target, "ingest_words_batch", corpus.total_words, seconds_since(start)));
+            }
+        }
+    }
+
+    static int prime_at_least(int n) {
+        auto is_prime = [](int x) {
+            for (int d = 2; d * d <= x; ++d) {
+                if (x % d == 0) return false;
+            }
+            return x >= 2;
+        };
+        while (!is_prime(n)) ++n;
+        return n;
+    }
+
+    // Fixed-capacity tables at load 0.5 over the vocabulary, and Linear and
+    // RobinHood again at 0.9: ns per insert, per find of a present key and
+    // per find of an absent key. Sets are also timed again once frozen.
+    void bench_tables(std::vector<Row>& rows) {
+        const auto& keys = corpus.vocabulary;
+        std::vector<std::string> absent;
+        absent.reserve(keys.size());
+        for (const auto& key : keys) {
+            absent.push_back(key + "#");
+        }
+        int capacity = prime_at_least(static_cast<int>(keys.size()) * 2);
+        int dense = prime_at_least(static_cast<int>(keys.size() / 0.9) + 1);
+        std::vector<std::tuple<std::string, std::string, std::vector<int>>> types = {
+            {"Linear", "Linear", {10, capacity}}, {"Double", "Double", {10, 37, 7, capacity}}, {"Chain", "Chain", {10, capacity}},
+            {"Swiss", "Swiss", {10, capacity}}, {"RobinHood", "RobinHood", {10, capacity}},
+            {"Linear-0.9", "Linear", {10, dense}}, {"RobinHood-0.9", "RobinHood", {10, dense}}};
+        for (const auto& [label, type, params] : types) {
+            for (HashFunction hash_function : {HashFunction::Polynomial, HashFunction::Fast}) {
+                std::string target = label + (hash_function == HashFunction::Fast ? "-Fast" : "-Polynomial");
+
+                HashSet set(type, params, hash_function);
+                auto start = Clock::now();
+                for (const auto& key : keys) {
+                    set.insert({key, key});
+                }
+                rows.push_back(throughput_row("HashSet", target, "insert", keys.size(), seconds_since(start)));
+                start = Clock::now();
+                for (const auto& key : keys) {
+                    checksum += set.find(key).has_value();
+                }
+                rows.push_back(throughput_row("HashSet", target, "find_hit", keys.size(), seconds_since(start)));
+                start = Clock::now();
+                for (const auto& key : absent) {
+                    checksum += set.find(key).has_value();
+                }
+                rows.push_back(throughput_row("HashSet", target, "find_miss", keys.size(), seconds_since(start)));
+
+                FrozenSet frozen = set.freeze();
+                start = Clock::now();
+                for (const auto& key : keys) {
+                    checksum += frozen.contains(key);
+                }
+                rows.push_back(throughput_row("FrozenSet", target, "find_hit", keys.size(), seconds_since(start)));
+                start = Clock::now();
+                for (const auto& key : absent) {
+                    checksum += frozen.contains(key);
+                }
+                rows.push_back(throughput_row("FrozenSet", target, "find_miss", keys.size(), seconds_since(start)));
+
+                HashMap<Count> map(type, params, hash_function);
+                start = Clock::now();
+                for (size_t i = 0; i < keys.size(); ++i) {
+                    map.insert({keys[i], Count{static_cast<int>(i)}});
+                }
+                rows.push_back(throughput_row("HashMap", target, "insert", keys.size(), seconds_since(start)));
+                start = Clock::now();
+                for (const auto& key : keys) {
+                    checksum += map.find_ptr(key)->value;
+                }
+                rows.push_back(throughput_row("HashMap", target, "find_hit", keys.size(), seconds_since(start)));
+                start = Clock::now();
+                for (const auto& key : absent) {
+                    checksum += map.find_ptr(key) != nullptr;
+                }
+                rows.push_back(throughput_row("HashMap", target, "find_miss", keys.size(), seconds_since(start)));
+            }
+        }
+    }
+
+    // Throughput-only rows print `missing` in the latency columns.
+    static std::string latency(const Row& r, double value, const std::string& missing) {
+        if (!r.has_latency) return missing;
+        std::ostringstream oss;
+        oss << value;
+        return oss.str();
+    }
+
+    void print_json(const std::vector<Row>& rows, std::ostream& out) const {
+        out << "{\n  \"config\": {\"books\": " << options.books << ", \"length\": " << options.length
+            << ", \"vocab\": " << options.vocab << ", \"skew\": " << options.skew << ", \"queries\": " << options.queries
+            << ", \"seed\": " << options.seed << ", \"threads\": " << options.threads << "},\n";
+        out << "  \"checksum\": " << checksum << ",\n  \"results\": [\n";
+        for (size_t i = 0; i < rows.size(); ++i) {
+            const Row& r = rows[i];
+            out << "    {\"suite\": \"" << r.suite << "\", \"target\": \"" << r.target << "\", \"op\": \"" << r.op
+                << "\", \"count\": " << r.count << ", \"total_s\": " << r.total_s << ", \"ops_per_s\": " << r.ops_per_s
+                << ", \"p50_ns\": " << latency(r, r.p50_ns, "null") << ", \"p99_ns\": " << latency(r, r.p99_ns, "null")
+                << ", \"p999_ns\": " << latency(r, r.p999_ns, "null") << "}"
+                << (i + 1 < rows.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}" << std::endl;
+    }
+
+    static void print_csv(const std::vector<Row>& rows, std::ostream& out) {
+        out << "suite,target,op,count,total_s,ops_per_s,p50_ns,p99_ns,p999_ns" << std::endl;
+        for (const Row& r : rows) {
+            out << r.suite << "," << r.target << "," << r.op << "," << r.count << "," << r.total_s << "," << r.ops_per_s
+                << "," << latency(r, r.p50_ns, "") << "," << latency(r, r.p99_ns, "") << "," << latency(r, r.p999_ns, "")
+                << std::endl;
+        }
+    }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,156 @@
+#ifndef DICTIONARY_HPP
+#define DICTIONARY_HPP
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+// Immutable sorted word -> ID map, front coded. Words are cut into blocks of
+// BLOCK_SIZE: the first word of a block is stored whole, every other word as
+// the length it shares with the word before it plus the rest. A lookup binary
+// searches the block heads and decodes at most one block to find its start,
+// then reads on in order, so prefix queries cost O(log blocks + matches).
+class Dictionary {
+public:
+    static constexpr int BLOCK_SIZE = 16;
+
+    class Cursor {
+    private:
+        const Dictionary* dictionary;
+        size_t offset;
+        size_t index;
+        std::string current;
+        uint32_t current_id;
+
+    public:
+        explicit Cursor(const Dictionary* dictionary_) : dictionary(dictionary_), offset(0), index(0), current_id(0) {}
+
+        bool done() const {
+            return index >= dictionary->count;
+        }
+
+        std::string_view word() const {
+            return current;
+        }
+
+        uint32_t id() const {
+            return current_id;
+        }
+
+        // Decodes the entry at offset, which follows the current word.
+        void load() {
+            if (done()) return;
+            const std::vector<char>& bytes = dictionary->bytes;
+            size_t shared = read_varint(bytes, offset);
+            size_t rest = read_varint(bytes, offset);
+            current.resize(shared);
+            current.append(bytes.data() + offset, rest);
+            offset += rest;
+            current_id = read_varint(bytes, offset);
+        }
+
+        void next() {
+            ++index;
+            load();
+        }
+
+        // Moves to the first word >= key.
+        void seek(std::string_view key) {
+            const std::vector<size_t>& heads = dictionary->heads;
+            size_t lo = 0, hi = heads.size();
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (dictionary->head(mid) < key) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            size_t block = lo > 0 ? lo - 1 : 0;
+            index = block * BLOCK_SIZE;
+            offset = block < heads.size() ? heads[block] : dictionary->bytes.size();
+            current.clear();
+            load();
+            while (!done() && std::string_view(current) < key) {
+                next();
+            }
+        }
+    };
+
+    Dictionary() = default;
+
+    // words must be sorted and distinct; ids[i] belongs to words[i].
+    Dictionary(const std::vector<std::string_view>& words, const std::vector<uint32_t>& ids) : count(words.size()) {
+        std::string_view previous;
+        for (size_t i = 0; i < words.size(); ++i) {
+            size_t shared = 0;
+            if (i % BLOCK_SIZE == 0) {
+                heads.push_back(bytes.size());
+            } else {
+                while (shared < previous.size() && shared < words[i].size() && previous[shared] == words[i][shared]) {
+                    ++shared;
+                }
+            }
+            write_varint(bytes, shared);
+            write_varint(bytes, words[i].size() - shared);
+            bytes.insert(bytes.end(), words[i].begin() + shared, words[i].end());
+            write_varint(bytes, ids[i]);
+            previous = words[i];
+        }
+        bytes.shrink_to_fit();
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    Cursor cursor() const {
+        Cursor it(this);
+        it.load();
+        return it;
+    }
+
+    Cursor lower_bound(std::string_view key) const {
+        Cursor it(this);
+        it.seek(key);
+        return it;
+    }
+
+private:
+    std::vector<char> bytes;
+    std::vector<size_t> heads;
+    size_t count = 0;
+
+    // Block heads share nothing with the word before them, so they can be
+    // read in place.
+    std::string_view head(size_t block) const {
+        size_t offset = heads[block];
+        read_varint(bytes, offset);
+        size_t length = read_varint(bytes, offset);
+        return std::string_view(bytes.data() + offset, length);
+    }
+
+    static void write_varint(std::vector<char>& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    static uint32_t read_varint(const std::vector<char>& in, size_t& offset) {
+        uint32_t value = 0;
+        int shift = 0;
+        while (static_cast<uint8_t>(in[offset]) & 0x80) {
+            value |= static_cast<uint32_t>(static_cast<uint8_t>(in[offset++]) & 0x7F) << shift;
+            shift += 7;
+        }
+        value |= static_cast<uint32_t>(static_cast<uint8_t>(in[offset++])) << shift;
+        return value;
+    }
+};
+
+#endif
\ No newline at end of file
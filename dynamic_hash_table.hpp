@@ -5,78 +5,233 @@
 #include "prime_generator.hpp"
 #include <vector>
 #include <string>
+#include <string_view>
 #include <optional>
-class DynamicHashSet : public HashSet {
+
+// Full moves every entry to the new storage as soon as the load threshold is
+// crossed. Incremental keeps the old storage next to the new one and moves
+// MIGRATION_STEP old slots per insert, so no single insert pays for the
+// whole table.
+enum class RehashMode {
+    Full,
+    Incremental
+};
+
+constexpr int MIGRATION_STEP = 8;
+
+// Capacity a table of the given growth policy moves to once it fills up.
+inline int next_capacity(Growth growth, int capacity) {
+    if (growth == Growth::Prime) {
+        return PrimeGenerator::next_prime_after(capacity);
+    } else if (growth == Growth::PowerOfTwo) {
+        return capacity * 2;
+    }
+    return PrimeGenerator::get_next_size();
+}
+
+template <typename Probing, typename Key = std::string>
+class BasicDynamicHashSet : public BasicHashSet<Probing, Key> {
 public:
-    DynamicHashSet(const std::string& collision_type, const std::vector<int>& params)
-        : HashSet(collision_type, params) {}
+    // The table grows once its load reaches max_load.
+    explicit BasicDynamicHashSet(const std::vector<int>& params, RehashMode mode_ = RehashMode::Full,
+                                 HashFunction hash_function = HashFunction::Polynomial, Growth growth = Growth::Prime,
+                                 double max_load = 0.5)
+        : BasicHashSet<Probing, Key>(params, hash_function, growth), mode(mode_) {
+        this->set_max_load(max_load);
+    }
 
-    void insert(const std::string& key) {
-        HashSet::insert({key, key});
-        if (get_load() >= 0.5) {
-            rehash();
+    // Repeated keys change nothing, so inserting a text word by word grows the
+    // set exactly like inserting its distinct words in first-seen order.
+    void insert(const Key& key) {
+        this->migrate(MIGRATION_STEP);
+        if (BasicHashSet<Probing, Key>::insert(key)) {
+            after_insert();
         }
     }
 
+    bool erase(const std::string& key) {
+        this->migrate(MIGRATION_STEP);
+        return BasicHashSet<Probing, Key>::erase(key);
+    }
+
 private:
-   void rehash() {
-    capacity = PrimeGenerator::get_next_size();
-    size = 0;
-    auto old_chain_data = chain_data;
-    auto old_linear_double_data = linear_double_data;
-    find_storage_according_to_collision_type();
-
-    if (collision_type == "Chain") {
-        for (const auto& bucket : old_chain_data) {
-            for (const auto& key : bucket) {
-                HashSet::insert({key.first, key.second});
-            }
-        }
-    } else {
-        for (const auto& key : old_linear_double_data) {
-            if (key.has_value()) {
-                HashSet::insert({key->first, key->second});
-            }
+    RehashMode mode;
+
+    void rehash() {
+        int next = next_capacity(this->growth, this->capacity);
+        if (mode == RehashMode::Incremental) {
+            this->begin_resize(next);
+        } else {
+            this->resize(next);
         }
     }
-}
 
+    // Below the max load, a table whose tombstones leave too few empty slots
+    // is rebuilt at the same capacity instead.
+    void after_insert() {
+        if (this->get_load() >= this->load_factor) {
+            rehash();
+        } else if (this->crowded()) {
+            this->resize(this->capacity);
+        }
+    }
 };
 
-class DynamicHashMap : public HashMap<DynamicHashSet> {
+template <typename ValueType, typename Probing>
+class BasicDynamicHashMap : public BasicHashMap<ValueType, Probing> {
 public:
-    DynamicHashMap(const std::string& collision_type, const std::vector<int>& params)
-        : HashMap<DynamicHashSet>(collision_type, params) {}
+    // The table grows once its load reaches max_load.
+    explicit BasicDynamicHashMap(const std::vector<int>& params, RehashMode mode_ = RehashMode::Full,
+                                 HashFunction hash_function = HashFunction::Polynomial, Growth growth = Growth::Prime,
+                                 double max_load = 0.5)
+        : BasicHashMap<ValueType, Probing>(params, hash_function, growth), mode(mode_) {
+        this->set_max_load(max_load);
+    }
 
-    void insert(const std::pair<std::string, DynamicHashSet>& x) {
-        HashMap<DynamicHashSet>::insert(x);
-        if (get_load() >= 0.5) {
-            rehash();
-        }
+    void insert(const std::pair<std::string, ValueType>& x) {
+        this->migrate(MIGRATION_STEP);
+        BasicHashMap<ValueType, Probing>::insert(x);
+        after_insert();
+    }
+
+    void insert(std::pair<std::string, ValueType>&& x) {
+        this->migrate(MIGRATION_STEP);
+        BasicHashMap<ValueType, Probing>::insert(std::move(x));
+        after_insert();
+    }
+
+    bool erase(const std::string& key) {
+        this->migrate(MIGRATION_STEP);
+        return BasicHashMap<ValueType, Probing>::erase(key);
     }
 
 private:
+    RehashMode mode;
+
     void rehash() {
-        capacity = PrimeGenerator::get_next_size();
-        size = 0;
-        auto old_chain_data = chain_data;
-        auto old_linear_double_data = linear_double_data;
-        find_storage_according_to_collision_type();
-
-        if (collision_type == "Chain") {
-            for (const auto& bucket : old_chain_data) {
-                for (const auto& kv : bucket) {
-                    insert(kv);
-                }
-            }
+        int next = next_capacity(this->growth, this->capacity);
+        if (mode == RehashMode::Incremental) {
+            this->begin_resize(next);
         } else {
-            for (const auto& kv : old_linear_double_data) {
-                if (kv.has_value()) {
-                    insert(*kv);
-                }
-            }
+            this->resize(next);
         }
     }
+
+    // Below the max load, a table whose tombstones leave too few empty slots
+    // is rebuilt at the same capacity instead.
+    void after_insert() {
+        if (this->get_load() >= this->load_factor) {
+            rehash();
+        } else if (this->crowded()) {
+            this->resize(this->capacity);
+        }
+    }
+};
+
+template <typename Key>
+struct DynamicHashSetOf {
+    template <typename Probing>
+    using type = BasicDynamicHashSet<Probing, Key>;
+};
+
+// Boxed: libraries keep one of these per book, so each costs only the
+// layout it uses.
+template <typename Key>
+class DynamicKeySet : public CollisionTypeDispatch<DynamicHashSetOf<Key>::template type, DispatchStorage::Boxed> {
+public:
+    DynamicKeySet(const std::string& collision_type, const std::vector<int>& params, RehashMode mode = RehashMode::Full,
+                  HashFunction hash_function = HashFunction::Polynomial, Growth growth = Growth::Prime, double max_load = 0.5)
+        : CollisionTypeDispatch<DynamicHashSetOf<Key>::template type, DispatchStorage::Boxed>(collision_type, params, mode,
+                                                                                               hash_function, growth, max_load) {}
+
+    void insert(const Key& key) {
+        this->visit([&](auto& t) { t.insert(key); });
+    }
+
+    bool contains(std::string_view key) const {
+        return this->visit([&](const auto& t) { return t.contains(key); });
+    }
+
+    std::optional<std::string> find(std::string_view key) const {
+        return this->visit([&](const auto& t) { return t.find(key); });
+    }
+
+    void find_batch(const std::vector<std::string_view>& keys, std::vector<bool>& found) const {
+        this->visit([&](const auto& t) { t.find_batch(keys, found); });
+    }
+
+    std::vector<std::string> keys() const {
+        return this->visit([](const auto& t) { return t.keys(); });
+    }
+
+    std::vector<std::string_view> views() const {
+        return this->visit([](const auto& t) { return t.views(); });
+    }
+
+    FrozenSet freeze() const {
+        return this->visit([](const auto& t) { return t.freeze(); });
+    }
+};
+
+using DynamicHashSet = DynamicKeySet<std::string>;
+
+// Stores views only: every inserted word must outlive the set, e.g. by
+// coming from a StringPool.
+using DynamicWordSet = DynamicKeySet<std::string_view>;
+
+template <typename ValueType>
+struct DynamicHashMapOf {
+    template <typename Probing>
+    using type = BasicDynamicHashMap<ValueType, Probing>;
+};
+
+template <typename ValueType = DynamicHashSet>
+class DynamicHashMap : public CollisionTypeDispatch<DynamicHashMapOf<ValueType>::template type> {
+public:
+    DynamicHashMap(const std::string& collision_type, const std::vector<int>& params, RehashMode mode = RehashMode::Full,
+                   HashFunction hash_function = HashFunction::Polynomial, Growth growth = Growth::Prime, double max_load = 0.5)
+        : CollisionTypeDispatch<DynamicHashMapOf<ValueType>::template type>(collision_type, params, mode, hash_function, growth,
+                                                                            max_load) {}
+
+    void insert(const std::pair<std::string, ValueType>& x) {
+        this->visit([&](auto& t) { t.insert(x); });
+    }
+
+    void insert(std::pair<std::string, ValueType>&& x) {
+        this->visit([&](auto& t) { t.insert(std::move(x)); });
+    }
+
+    bool contains(std::string_view key) const {
+        return this->visit([&](const auto& t) { return t.contains(key); });
+    }
+
+    // Copies the value, a whole set for a map of sets; prefer find_ptr().
+    std::optional<ValueType> find(std::string_view key) const {
+        return this->visit([&](const auto& t) { return t.find(key); });
+    }
+
+    const ValueType* find_ptr(std::string_view key) const {
+        return this->visit([&](const auto& t) { return t.find_ptr(key); });
+    }
+
+    const ValueType& find_ref(std::string_view key) const {
+        return this->visit([&](const auto& t) -> const ValueType& { return t.find_ref(key); });
+    }
+
+    void find_batch(const std::vector<std::string_view>& keys, std::vector<const ValueType*>& out) const {
+        this->visit([&](const auto& t) { t.find_batch(keys, out); });
+    }
+
+    FrozenMap<ValueType> freeze() const {
+        return this->visit([](const auto& t) { return t.freeze(); });
+    }
+
+    // Stores convert(value) for each value; a map of sets freezes its sets
+    // with [](const auto& set) { return set.freeze(); }.
+    template <typename Convert>
+    auto freeze(Convert&& convert) const {
+        return this->visit([&](const auto& t) { return t.freeze(convert); });
+    }
 };
 
 #endif
\ No newline at end of file
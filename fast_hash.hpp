@@ -0,0 +1,120 @@
+#ifndef FAST_HASH_HPP
+#define FAST_HASH_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+// 64-bit string hash in the style of wyhash: input is consumed as 8-byte
+// words and mixed with 64x64->128 bit multiplies. Every byte of the key
+// contributes, so punctuation and UTF-8 text hash as well as letters do.
+namespace FastHash
+{
+    constexpr uint64_t SECRET0 = 0xa0761d6478bd642full;
+    constexpr uint64_t SECRET1 = 0xe7037ed1a0b428dbull;
+    constexpr uint64_t SECRET2 = 0x8ebc6af09c88c6e3ull;
+
+    inline void mum(uint64_t& a, uint64_t& b)
+    {
+#if defined(__SIZEOF_INT128__)
+        __uint128_t r = static_cast<__uint128_t>(a) * b;
+        a = static_cast<uint64_t>(r);
+        b = static_cast<uint64_t>(r >> 64);
+#else
+        uint64_t ha = a >> 32, hb = b >> 32, la = static_cast<uint32_t>(a), lb = static_cast<uint32_t>(b);
+        uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+        uint64_t t = rl + (rm0 << 32);
+        uint64_t c = t < rl;
+        uint64_t lo = t + (rm1 << 32);
+        c += lo < t;
+        uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+        a = lo;
+        b = hi;
+#endif
+    }
+
+    inline uint64_t mix(uint64_t a, uint64_t b)
+    {
+        mum(a, b);
+        return a ^ b;
+    }
+
+    inline uint64_t read64(const char* p)
+    {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline uint64_t read32(const char* p)
+    {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    // Keys shorter than 4 bytes are packed from their first, middle and last byte.
+    inline uint64_t read_small(const char* p, size_t len)
+    {
+        return (static_cast<uint64_t>(static_cast<unsigned char>(p[0])) << 16) |
+               (static_cast<uint64_t>(static_cast<unsigned char>(p[len >> 1])) << 8) |
+               static_cast<unsigned char>(p[len - 1]);
+    }
+
+    inline uint64_t hash(const char* p, size_t len, uint64_t seed = 0)
+    {
+        seed ^= mix(seed ^ SECRET0, SECRET1);
+        uint64_t a, b;
+        if (len <= 16)
+        {
+            if (len >= 4)
+            {
+                size_t shift = (len >> 3) << 2;
+                a = (read32(p) << 32) | read32(p + shift);
+                b = (read32(p + len - 4) << 32) | read32(p + len - 4 - shift);
+            }
+            else if (len > 0)
+            {
+                a = read_small(p, len);
+                b = 0;
+            }
+            else
+            {
+                a = b = 0;
+            }
+        }
+        else
+        {
+            size_t i = len;
+            while (i > 16)
+            {
+                seed = mix(read64(p) ^ SECRET1, read64(p + 8) ^ seed);
+                p += 16;
+                i -= 16;
+            }
+            a = read64(p + i - 16);
+            b = read64(p + i - 8);
+        }
+        a ^= SECRET1;
+        b ^= seed;
+        mum(a, b);
+        return mix(a ^ SECRET0 ^ len, b ^ SECRET1 ^ SECRET2);
+    }
+
+    inline uint64_t hash(std::string_view key, uint64_t seed = 0)
+    {
+        return hash(key.data(), key.size(), seed);
+    }
+
+    // Hasher for std::unordered_* containers keyed by strings.
+    struct Hasher
+    {
+        size_t operator()(std::string_view key) const
+        {
+            return static_cast<size_t>(hash(key));
+        }
+    };
+}
+
+#endif
\ No newline at end of file
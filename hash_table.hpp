@@ -3,37 +3,219 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <optional>
 #include <stdexcept>
 #include <variant>
+#include <utility>
+#include <type_traits>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <chrono>
+#include "fast_hash.hpp"
+#include "prefetch.hpp"
 
-template <typename ValueType>
-class HashTable {
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Collision strategies. A table is specialized on one of these at compile
+// time, so probing needs no per-call dispatch and only the storage the
+// strategy uses is allocated.
+// Polynomial is the original per-character polynomial, kept so existing
+// get_slot layouts stay reproducible. Fast is FastHash::hash.
+enum class HashFunction {
+    Polynomial,
+    Fast
+};
+
+// How a dynamic table picks its next capacity. Prime, the default, walks
+// PrimeGenerator::GROWTH_PRIMES and PowerOfTwo doubles; both keep their
+// state in the table. Shared must be asked for: it pops the process-wide
+// list filled by PrimeGenerator::set_primes(), the original behaviour the
+// reference layouts depend on, so every Shared table takes sizes the others
+// would have used. A PowerOfTwo table starts at params.back() rounded up to
+// a power of two. Swiss tables are always a power of two.
+enum class Growth {
+    Shared,
+    Prime,
+    PowerOfTwo
+};
+
+struct LinearProbing {
+    static constexpr const char* name = "Linear";
+    static constexpr bool chained = false;
+};
+
+struct DoubleProbing {
+    static constexpr const char* name = "Double";
+    static constexpr bool chained = false;
+};
+
+struct ChainProbing {
+    static constexpr const char* name = "Chain";
+    static constexpr bool chained = true;
+};
+
+struct SwissProbing {
+    static constexpr const char* name = "Swiss";
+    static constexpr bool chained = false;
+};
+
+struct RobinHoodProbing {
+    static constexpr const char* name = "RobinHood";
+    static constexpr bool chained = false;
+};
+
+// Value type of tables that only store keys. Their entries hold the key alone
+// instead of a pair, so a set of words keeps each word once.
+struct KeyOnly {};
+
+template <typename Key, typename ValueType>
+struct EntryOf {
+    using type = std::pair<Key, ValueType>;
+};
+
+template <typename Key>
+struct EntryOf<Key, KeyOnly> {
+    struct type {
+        Key first;
+    };
+};
+
+// Snapshot returned by stats(). The probe, compare and rehash counters are
+// only collected when HASH_TABLE_STATS is defined (counting is then true);
+// otherwise they stay zero and the hooks that feed them compile away.
+struct TableStats {
+    static constexpr int PROBE_BUCKETS = 64;
+
+    int size = 0;
+    int capacity = 0;
+    int tombstones = 0;
+    double load = 0;
+    bool counting = false;
+    // Lookups by the number of slots they inspected: chain entries for
+    // Chain, 16-slot groups for Swiss. The last bucket also counts every
+    // longer probe.
+    std::vector<uint64_t> hit_probes;
+    std::vector<uint64_t> miss_probes;
+    // Chain only: chain_lengths[k] buckets hold k entries.
+    std::vector<uint64_t> chain_lengths;
+    // Key string compares, made only after the cached hashes matched.
+    uint64_t key_compares = 0;
+    uint64_t rehashes = 0;
+    double rehash_seconds = 0;
+    // sizeof(Slot) per entry moved by a rehash; key buffers are moved, not
+    // copied.
+    uint64_t bytes_moved = 0;
+};
+
+// Maps a hash onto [0, size). A table of any size gets exactly hash % size,
+// through Lemire's fastmod where 128-bit integers exist: the reciprocal is
+// computed once per capacity, so lookups multiply instead of dividing. A
+// PowerOfTwo table takes the top bits of a Fibonacci multiply instead, as a
+// mask of the low bits would only see the first characters of a
+// polynomial hash.
+class SlotRange {
+private:
+    static constexpr uint64_t FIBONACCI = 0x9e3779b97f4a7c15ull;
+
+    int slots = 1;
+    int shift = 0;
+#if defined(__SIZEOF_INT128__)
+    __uint128_t reciprocal = 0;
+#endif
+
+public:
+    SlotRange() = default;
+
+    SlotRange(int slots_, bool power_of_two) : slots(slots_) {
+        if (power_of_two) {
+            shift = 64;
+            for (int n = slots; n > 1; n >>= 1) {
+                shift--;
+            }
+        }
+#if defined(__SIZEOF_INT128__)
+        reciprocal = ~static_cast<__uint128_t>(0) / static_cast<uint64_t>(slots) + 1;
+#endif
+    }
+
+    int operator()(uint64_t hash) const {
+        if (shift != 0) {
+            return static_cast<int>((hash * FIBONACCI) >> shift);
+        }
+#if defined(__SIZEOF_INT128__)
+        __uint128_t low = reciprocal * hash;
+        uint64_t d = static_cast<uint64_t>(slots);
+        __uint128_t bottom = (static_cast<__uint128_t>(static_cast<uint64_t>(low)) * d) >> 64;
+        return static_cast<int>((bottom + static_cast<__uint128_t>(static_cast<uint64_t>(low >> 64)) * d) >> 64);
+#else
+        return static_cast<int>(hash % static_cast<uint64_t>(slots));
+#endif
+    }
+
+    int size() const {
+        return slots;
+    }
+
+    bool power_of_two() const {
+        return shift != 0;
+    }
+};
+
+// The parts of a params vector a table reads after construction: z of the
+// polynomial hash, params[0], and for Double probing z2 and c2 of the step
+// polynomial, params[1] and params[2]. Held inline, so a table owns no
+// params allocation; params.back(), the initial capacity, is not kept.
+struct HashParams {
+    int z = 0;
+    int z2 = 0;
+    int c2 = 0;
+
+    HashParams() = default;
+
+    explicit HashParams(const std::vector<int>& params) {
+        if (params.empty()) {
+            throw std::invalid_argument("Params vector cannot be empty");
+        }
+        z = params[0];
+        z2 = params.size() > 1 ? params[1] : 0;
+        c2 = params.size() > 2 ? params[2] : 0;
+    }
+};
+
+// State and hashing shared by every table layout.
+class HashTableBase {
 protected:
-    std::string collision_type;
-    std::vector<int> params;
+    // Keys a batched lookup has in flight at once.
+    static constexpr size_t BATCH = 16;
+
+    HashParams params;
     int capacity;
     int size;
+    int tombstones;
+    // Load at which a dynamic table grows.
     double load_factor;
-    std::vector<std::vector<std::pair<std::string, ValueType>>> chain_data;
-    std::vector<std::optional<std::pair<std::string, ValueType>>> linear_double_data;
+    HashFunction hash_function;
+    Growth growth;
+    // Reduces hashes onto the current capacity.
+    SlotRange range;
 
-    void find_storage_according_to_collision_type() {
-        if (collision_type == "Chain") {
-            chain_data = std::vector<std::vector<std::pair<std::string, ValueType>>>(capacity);
-            linear_double_data.clear();
-        } else {
-            linear_double_data = std::vector<std::optional<std::pair<std::string, ValueType>>>(capacity, std::nullopt);
-            chain_data.clear();
+    // Polynomial mode sums the original per-character polynomial in wrapping
+    // 64-bit arithmetic. Reduced modulo the capacity it gives the same slot as
+    // the int version for every key that never overflowed an int.
+    uint64_t hash_of(std::string_view key) const {
+        if (hash_function == HashFunction::Fast) {
+            return FastHash::hash(key);
         }
-    }
-
-    int hashing(const std::string& key) const {
-        int z = params[0];
-        int exp = 1;
-        int hash_key = 0;
+        uint64_t z = static_cast<uint64_t>(params.z);
+        uint64_t exp = 1;
+        uint64_t hash_key = 0;
         for (char c : key) {
-            int num = 0;
+            uint64_t num = 0;
             if ('a' <= c && c <= 'z') {
                 num = c - 'a';
             } else if ('A' <= c && c <= 'Z') {
@@ -41,53 +223,139 @@ protected:
             } else if ('0' <= c && c <= '9') {
                 num = c - '0' + 52;
             }
-            num *= exp;
+            hash_key += num * exp;
             exp *= z;
-            hash_key += num;
         }
-        return hash_key % capacity;
+        return hash_key;
     }
 
-    int double_hash(const std::string& key) const {
-        if (collision_type != "Double") return 1;
-        int z = params[1];
-        int c2 = params[2];
-        int exp = 1;
-        int hash_key = 0;
-        for (char c : key) {
-            int num = 0;
-            if ('a' <= c && c <= 'z') {
-                num = c - 'a';
-            } else if ('A' <= c && c <= 'Z') {
-                num = c - 'A' + 26;
+    // A PowerOfTwo table rounds new_capacity up to a power of two, at least 2.
+    void set_capacity(int new_capacity) {
+        if (growth == Growth::PowerOfTwo) {
+            int rounded = 2;
+            while (rounded < new_capacity) {
+                rounded *= 2;
             }
-            num *= exp;
-            exp *= z;
-            hash_key += num;
+            new_capacity = rounded;
         }
-        hash_key = c2 - (hash_key % c2);
-        return (hash_key == capacity) ? 1 : (hash_key != 0 ? hash_key : 1);
+        capacity = new_capacity;
+        range = SlotRange(capacity, growth == Growth::PowerOfTwo);
     }
 
-public:
-    HashTable(const std::string& collision_type_, const std::vector<int>& params_)
-        : collision_type(collision_type_), params(params_), size(0), load_factor(0.5) {
-        if (params.empty()) {
-            throw std::invalid_argument("Params vector cannot be empty");
+    void set_max_load(double max_load) {
+        if (!(max_load > 0 && max_load < 1)) {
+            throw std::invalid_argument("Max load must be between 0 and 1");
+        }
+        load_factor = max_load;
+    }
+
+    // Whether entries and tombstones together leave so few empty slots that
+    // misses would probe too far. Below a 0.5 max load the tombstone limit
+    // of erase() always comes first.
+    bool crowded() const {
+        return (size + tombstones) * 2.0 >= capacity * (1 + load_factor);
+    }
+
+    static int slot_for(uint64_t hash, int modulus) {
+        return static_cast<int>(hash % static_cast<uint64_t>(modulus));
+    }
+
+    static std::string join(const std::vector<std::string>& items, const std::string& delimiter) {
+        std::string result;
+        for (size_t i = 0; i < items.size(); ++i) {
+            result += items[i];
+            if (i < items.size() - 1) result += delimiter;
         }
-        capacity = params.back();
-        find_storage_according_to_collision_type();
+        return result;
+    }
+
+    HashTableBase(const std::vector<int>& params_, HashFunction hash_function_, Growth growth_ = Growth::Prime)
+        : params(params_), size(0), tombstones(0), load_factor(0.5), hash_function(hash_function_), growth(growth_) {
+        set_capacity(params_.back());
+#if defined(HASH_TABLE_STATS)
+        counters.counting = true;
+        counters.hit_probes.assign(TableStats::PROBE_BUCKETS, 0);
+        counters.miss_probes.assign(TableStats::PROBE_BUCKETS, 0);
+#endif
+    }
+
+#if defined(HASH_TABLE_STATS)
+    mutable TableStats counters;
+#endif
+
+    void count_probe(bool found, int length) const {
+#if defined(HASH_TABLE_STATS)
+        auto& histogram = found ? counters.hit_probes : counters.miss_probes;
+        histogram[std::min(length, TableStats::PROBE_BUCKETS - 1)]++;
+#else
+        (void)found;
+        (void)length;
+#endif
+    }
+
+    template <typename Key>
+    bool same_key(const Key& stored, std::string_view key) const {
+#if defined(HASH_TABLE_STATS)
+        counters.key_compares++;
+#endif
+        return stored == key;
+    }
+
+    void count_rehash() const {
+#if defined(HASH_TABLE_STATS)
+        counters.rehashes++;
+#endif
+    }
+
+    void count_moved(size_t bytes) const {
+#if defined(HASH_TABLE_STATS)
+        counters.bytes_moved += bytes;
+#else
+        (void)bytes;
+#endif
     }
 
-    virtual void insert(const std::pair<std::string, ValueType>& x) = 0;
-    virtual std::optional<ValueType> find(const std::string& key) const = 0;
-    virtual std::variant<int, std::pair<int, int>> get_slot(const std::string& key) const = 0;
-    virtual std::string to_string() const = 0;
+    // Adds its lifetime to the rehash time.
+    class RehashTimer {
+#if defined(HASH_TABLE_STATS)
+    private:
+        const HashTableBase& table;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        explicit RehashTimer(const HashTableBase& table_) : table(table_), start(std::chrono::steady_clock::now()) {}
+
+        ~RehashTimer() {
+            table.counters.rehash_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+#else
+    public:
+        explicit RehashTimer(const HashTableBase&) {}
+#endif
+    };
+
+public:
+    TableStats stats() const {
+#if defined(HASH_TABLE_STATS)
+        TableStats result = counters;
+#else
+        TableStats result;
+#endif
+        result.size = size;
+        result.capacity = capacity;
+        result.tombstones = tombstones;
+        result.load = get_load();
+        return result;
+    }
 
     double get_load() const {
         return static_cast<double>(size) / capacity;
     }
 
+    double get_max_load() const {
+        return load_factor;
+    }
+
     int get_size() const {
         return size;
     }
@@ -97,329 +365,1558 @@ public:
     }
 };
 
-class HashSet : public HashTable<std::string> {
-public:
-    HashSet(const std::string& collision_type, const std::vector<int>& params)
-        : HashTable<std::string>(collision_type, params) {}
-
-    void insert(const std::pair<std::string, std::string>& x) override {
-        if (collision_type == "Linear") {
-            insert_util_1(x.first);
-        } else if (collision_type == "Double") {
-            insert_util_2(x.first);
-        } else if (collision_type == "Chain") {
-            insert_util_3(x.first);
+template <typename ValueType>
+class FrozenTable;
+
+// Key is std::string, or std::string_view for tables whose keys are owned
+// elsewhere (see StringPool). Lookups always take a std::string_view.
+template <typename ValueType, typename Probing, typename Key = std::string>
+class HashTable : public HashTableBase {
+    template <typename>
+    friend class FrozenTable;
+
+protected:
+    using Entry = typename EntryOf<Key, ValueType>::type;
+
+    // Each entry keeps the full hash of its key. Probes compare it before the
+    // strings, and resizes reuse it instead of hashing the key again.
+    struct Slot {
+        uint64_t hash;
+        Entry kv;
+    };
+
+    // An open-addressing cell that held an entry which was erased or moved
+    // out by an incremental resize. It keeps probe sequences going past it.
+    struct Tombstone {};
+
+    using Cell = std::variant<std::monostate, Tombstone, Slot>;
+    using Bucket = std::conditional_t<Probing::chained, std::vector<Slot>, Cell>;
+
+    struct ProbeResult {
+        int index;
+        bool found;
+    };
+
+    // Storage left behind by an incremental resize. Its slots are moved into
+    // data a few at a time, starting from cursor.
+    struct Draining {
+        std::vector<Bucket> data;
+        SlotRange slots;
+        int cursor;
+    };
+
+    std::vector<Bucket> data;
+    std::optional<Draining> draining;
+
+    // Fast mode takes the step from the high half of the cached hash; the
+    // polynomial mode recomputes its second polynomial from the key. The step
+    // is returned in [1, slots.size()), and odd in a power-of-two table so the
+    // probe sequence visits every slot. A step that is a multiple of the
+    // capacity would probe one slot forever and becomes 1 instead; any other
+    // step is reduced modulo the capacity, as the original probing did.
+    int double_hash(std::string_view key, uint64_t hash, const SlotRange& slots) const {
+        if constexpr (!std::is_same_v<Probing, DoubleProbing>) {
+            return 1;
         } else {
-            throw std::invalid_argument("Invalid collision type");
+            int c2 = params.c2;
+            uint64_t sum = hash >> 32;
+            if (hash_function == HashFunction::Polynomial) {
+                uint64_t z = static_cast<uint64_t>(params.z2);
+                uint64_t exp = 1;
+                sum = 0;
+                for (char c : key) {
+                    uint64_t num = 0;
+                    if ('a' <= c && c <= 'z') {
+                        num = c - 'a';
+                    } else if ('A' <= c && c <= 'Z') {
+                        num = c - 'A' + 26;
+                    }
+                    sum += num * exp;
+                    exp *= z;
+                }
+            }
+            int hash_key = c2 - slot_for(sum, c2);
+            int step = (hash_key == slots.size()) ? 1 : (hash_key != 0 ? hash_key : 1);
+            if (step >= slots.size()) step %= slots.size();
+            if (step == 0) step = 1;
+            return slots.power_of_two() ? (step | 1) : step;
         }
     }
 
-    std::optional<std::string> find(const std::string& key) const override {
-        if (collision_type == "Linear") {
-            return search_util_1(key) ? std::optional<std::string>(key) : std::nullopt;
-        } else if (collision_type == "Double") {
-            return search_util_2(key) ? std::optional<std::string>(key) : std::nullopt;
-        } else if (collision_type == "Chain") {
-            return search_util_3(key) ? std::optional<std::string>(key) : std::nullopt;
-        }
-        return std::nullopt;
+    static bool is_empty(const Cell& cell) {
+        return std::holds_alternative<std::monostate>(cell);
     }
 
-    std::variant<int, std::pair<int, int>> get_slot(const std::string& key) const override {
-        if (collision_type == "Chain") {
-            int hash_key = hashing(key);
-            for (size_t idx = 0; idx < chain_data[hash_key].size(); ++idx) {
-                if (chain_data[hash_key][idx].first == key) {
-                    return std::pair<int, int>{hash_key, static_cast<int>(idx)};
-                }
-            }
-            return std::pair<int, int>{hash_key, -1};
-        } else if (collision_type == "Linear") {
-            int hash_key = hashing(key);
-            while (linear_double_data[hash_key].has_value()) {
-                if (linear_double_data[hash_key]->first == key) {
-                    return hash_key;
-                }
-                hash_key = (hash_key + 1) % capacity;
-            }
-            return hash_key;
-        } else if (collision_type == "Double") {
-            int hash_key = hashing(key);
-            int step = double_hash(key);
-            while (linear_double_data[hash_key].has_value()) {
-                if (linear_double_data[hash_key]->first == key) {
-                    return hash_key;
-                }
-                hash_key = (hash_key + step) % capacity;
-            }
-            return hash_key;
-        }
-        throw std::invalid_argument("Invalid collision type");
+    static const Slot* full(const Cell& cell) {
+        return std::get_if<Slot>(&cell);
     }
 
-    std::string to_string() const override {
-        std::vector<std::string> items;
-        if (collision_type == "Linear" || collision_type == "Double") {
-            for (const auto& item : linear_double_data) {
-                items.push_back(item.has_value() ? item->first : "<EMPTY>");
-            }
-        } else if (collision_type == "Chain") {
-            for (const auto& bucket : chain_data) {
-                if (bucket.empty()) {
-                    items.push_back("<EMPTY>");
-                } else {
-                    std::string aggregate;
-                    for (size_t i = 0; i < bucket.size(); ++i) {
-                        aggregate += bucket[i].first;
-                        if (i < bucket.size() - 1) aggregate += " ; ";
-                    }
-                    items.push_back(aggregate);
+    // Open addressing only. Finds the slot of storage holding key; if the key
+    // is absent, index is where an insert goes: the first tombstone on the
+    // probe sequence, or the empty slot that ends it.
+    ProbeResult probe(const std::vector<Bucket>& storage, const SlotRange& slots, std::string_view key, uint64_t hash) const {
+        int hash_key = slots(hash);
+        int step = double_hash(key, hash, slots);
+        int reusable = -1;
+        int length = 1;
+        while (!is_empty(storage[hash_key])) {
+            if (const Slot* slot = full(storage[hash_key])) {
+                if (slot->hash == hash && this->same_key(slot->kv.first, key)) {
+                    this->count_probe(true, length);
+                    return {hash_key, true};
                 }
+            } else if (reusable < 0) {
+                reusable = hash_key;
             }
+            hash_key += step;
+            if (hash_key >= slots.size()) hash_key -= slots.size();
+            length++;
         }
-        return join(items, " | ");
+        this->count_probe(false, length);
+        return {reusable >= 0 ? reusable : hash_key, false};
     }
 
-private:
-    void insert_util_1(const std::string& key) {
-        int hash_key = hashing(key);
-        while (linear_double_data[hash_key].has_value()) {
-            if (linear_double_data[hash_key]->first == key) {
-                return;
+    // Chain only. Position of key in bucket, or -1.
+    int find_in_bucket(const std::vector<Slot>& bucket, std::string_view key, uint64_t hash) const {
+        for (size_t i = 0; i < bucket.size(); ++i) {
+            if (bucket[i].hash == hash && this->same_key(bucket[i].kv.first, key)) {
+                this->count_probe(true, static_cast<int>(i) + 1);
+                return static_cast<int>(i);
             }
-            hash_key = (hash_key + 1) % capacity;
         }
-        linear_double_data[hash_key] = {key, key};
-        size++;
+        this->count_probe(false, static_cast<int>(bucket.size()));
+        return -1;
     }
 
-    void insert_util_2(const std::string& key) {
-        int hash_key = hashing(key);
-        int double_hash_value = double_hash(key);
-        while (linear_double_data[hash_key].has_value()) {
-            if (linear_double_data[hash_key]->first == key) {
-                return;
-            }
-            hash_key = (hash_key + double_hash_value) % capacity;
+    const Entry* locate_in(const std::vector<Bucket>& storage, const SlotRange& slots, std::string_view key, uint64_t hash) const {
+        if constexpr (Probing::chained) {
+            const auto& bucket = storage[slots(hash)];
+            int at = find_in_bucket(bucket, key, hash);
+            return at >= 0 ? &bucket[at].kv : nullptr;
+        } else {
+            ProbeResult at = probe(storage, slots, key, hash);
+            return at.found ? &full(storage[at.index])->kv : nullptr;
         }
-        linear_double_data[hash_key] = {key, key};
-        size++;
     }
 
-    void insert_util_3(const std::string& key) {
-        int hash_key = hashing(key);
-        for (const auto& kv : chain_data[hash_key]) {
-            if (kv.first == key) return;
+    const Entry* locate(std::string_view key, uint64_t hash) const {
+        const Entry* kv = locate_in(data, range, key, hash);
+        if (kv == nullptr && draining) {
+            kv = locate_in(draining->data, draining->slots, key, hash);
         }
-        chain_data[hash_key].push_back({key, key});
-        size++;
+        return kv;
     }
 
-    bool search_util_1(const std::string& key) const {
-        int hash_key = hashing(key);
-        while (linear_double_data[hash_key].has_value()) {
-            if (linear_double_data[hash_key]->first == key) {
-                return true;
+    const Entry* locate(std::string_view key) const {
+        return locate(key, hash_of(key));
+    }
+
+    // Calls out(i, entry or nullptr) for every keys[i]. Keys go BATCH at a
+    // time: all of a group are hashed and their home buckets prefetched
+    // before the first is probed, and chained buckets get a second round for
+    // their slot arrays, so the cache misses overlap.
+    template <typename Out>
+    void locate_batch(const std::string_view* keys, size_t n, Out&& out) const {
+        uint64_t hashes[BATCH];
+        for (size_t first = 0; first < n; first += BATCH) {
+            size_t count = std::min(BATCH, n - first);
+            for (size_t i = 0; i < count; ++i) {
+                hashes[i] = hash_of(keys[first + i]);
+                prefetch(&data[range(hashes[i])]);
+            }
+            if constexpr (Probing::chained) {
+                for (size_t i = 0; i < count; ++i) {
+                    prefetch(data[range(hashes[i])].data());
+                }
+            }
+            for (size_t i = 0; i < count; ++i) {
+                out(first + i, locate(keys[first + i], hashes[i]));
             }
-            hash_key = (hash_key + 1) % capacity;
         }
-        return false;
     }
 
-    bool search_util_2(const std::string& key) const {
-        int hash_key = hashing(key);
-        int step = double_hash(key);
-        while (linear_double_data[hash_key].has_value()) {
-            if (linear_double_data[hash_key]->first == key) {
-                return true;
-            }
-            hash_key = (hash_key + step) % capacity;
+    Entry* locate(std::string_view key) {
+        return const_cast<Entry*>(std::as_const(*this).locate(key));
+    }
+
+    // Returns the entry holding key and whether it was just inserted. make()
+    // builds the entry and is only called when the key is absent.
+    template <typename Make>
+    std::pair<Entry*, bool> find_or_insert(std::string_view key, Make&& make) {
+        uint64_t hash = hash_of(key);
+        if (draining) {
+            const Entry* old = locate_in(draining->data, draining->slots, key, hash);
+            if (old != nullptr) return {const_cast<Entry*>(old), false};
+        }
+        if constexpr (Probing::chained) {
+            auto& bucket = data[range(hash)];
+            int at = find_in_bucket(bucket, key, hash);
+            if (at >= 0) return {&bucket[at].kv, false};
+            bucket.push_back(Slot{hash, make()});
+            size++;
+            return {&bucket.back().kv, true};
+        } else {
+            ProbeResult at = probe(data, range, key, hash);
+            Cell& cell = data[at.index];
+            if (at.found) return {&std::get<Slot>(cell).kv, false};
+            if (!is_empty(cell)) tombstones--;
+            Slot& slot = cell.template emplace<Slot>(Slot{hash, make()});
+            size++;
+            return {&slot.kv, true};
         }
-        return false;
     }
 
-    bool search_util_3(const std::string& key) const {
-        int hash_key = hashing(key);
-        for (const auto& kv : chain_data[hash_key]) {
-            if (kv.first == key) return true;
+    // Stores x unless its key is already present; x is left untouched if it was.
+    template <typename E>
+    std::pair<Entry*, bool> emplace(E&& x) {
+        return find_or_insert(x.first, [&]() { return Entry(std::forward<E>(x)); });
+    }
+
+    // Moves a slot whose key is known to be absent into the current storage,
+    // using its cached hash.
+    void place(Slot&& slot) {
+        int hash_key = range(slot.hash);
+        if constexpr (Probing::chained) {
+            data[hash_key].push_back(std::move(slot));
+        } else {
+            int step = double_hash(slot.kv.first, slot.hash, range);
+            while (full(data[hash_key])) {
+                hash_key += step;
+                if (hash_key >= capacity) hash_key -= capacity;
+            }
+            if (!is_empty(data[hash_key])) tombstones--;
+            data[hash_key].template emplace<Slot>(std::move(slot));
         }
-        return false;
     }
 
-    std::string join(const std::vector<std::string>& items, const std::string& delimiter) const {
-        std::string result;
-        for (size_t i = 0; i < items.size(); ++i) {
-            result += items[i];
-            if (i < items.size() - 1) result += delimiter;
+    // Swaps in empty storage of the new capacity. The old entries stay
+    // reachable and are moved over by migrate().
+    void begin_resize(int new_capacity) {
+        finish_rehash();
+        this->count_rehash();
+        RehashTimer timer(*this);
+        draining = Draining{std::move(data), range, 0};
+        set_capacity(new_capacity);
+        tombstones = 0;
+        data = std::vector<Bucket>(capacity);
+    }
+
+    // Moves up to `slots` old slots into the current storage.
+    void migrate(int slots) {
+        if (!draining) return;
+        RehashTimer timer(*this);
+        int end = draining->cursor + std::min(slots, draining->slots.size() - draining->cursor);
+        for (; draining->cursor < end; ++draining->cursor) {
+            auto& bucket = draining->data[draining->cursor];
+            if constexpr (Probing::chained) {
+                for (auto& slot : bucket) {
+                    place(std::move(slot));
+                }
+                this->count_moved(bucket.size() * sizeof(Slot));
+                bucket = Bucket();
+            } else if (Slot* slot = std::get_if<Slot>(&bucket)) {
+                place(std::move(*slot));
+                this->count_moved(sizeof(Slot));
+                bucket.template emplace<Tombstone>();
+            }
+        }
+        if (draining->cursor == draining->slots.size()) {
+            draining.reset();
         }
-        return result;
     }
-};
 
-template <typename ValueType>
-class HashMap : public HashTable<ValueType> {
-public:
-    HashMap(const std::string& collision_type, const std::vector<int>& params)
-        : HashTable<ValueType>(collision_type, params) {}
-
-    void insert(const std::pair<std::string, ValueType>& x) override {
-        if (this->collision_type == "Linear") {
-            insert_util_1(x);
-        } else if (this->collision_type == "Double") {
-            insert_util_2(x);
-        } else if (this->collision_type == "Chain") {
-            insert_util_3(x);
+    // Moves every entry into fresh storage of the given capacity.
+    void resize(int new_capacity) {
+        begin_resize(new_capacity);
+        finish_rehash();
+    }
+
+    // Removes key from one storage. In the current storage Linear probing
+    // shifts the rest of the cluster back over the hole and Double probing
+    // leaves a tombstone; storage being drained always gets a tombstone.
+    bool erase_in(std::vector<Bucket>& storage, const SlotRange& slots, std::string_view key, uint64_t hash, bool current) {
+        if constexpr (Probing::chained) {
+            auto& bucket = storage[slots(hash)];
+            int at = find_in_bucket(bucket, key, hash);
+            if (at < 0) return false;
+            bucket.erase(bucket.begin() + at);
+            return true;
         } else {
-            throw std::invalid_argument("Invalid collision type");
+            ProbeResult at = probe(storage, slots, key, hash);
+            if (!at.found) return false;
+            if (current && std::is_same_v<Probing, LinearProbing>) {
+                backward_shift(at.index);
+            } else {
+                storage[at.index].template emplace<Tombstone>();
+                if (current) tombstones++;
+            }
+            return true;
         }
     }
 
-    std::optional<ValueType> find(const std::string& key) const override {
-        if (this->collision_type == "Linear") {
-            return search_util_1(key);
-        } else if (this->collision_type == "Double") {
-            return search_util_2(key);
-        } else if (this->collision_type == "Chain") {
-            return search_util_3(key);
+    // Linear probing only: empties data[hole] and pulls later entries of the
+    // cluster back into it, so lookups never need tombstones.
+    void backward_shift(int hole) {
+        int next = (hole + 1 == capacity) ? 0 : hole + 1;
+        while (const Slot* slot = full(data[next])) {
+            int home = range(slot->hash);
+            bool stays = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+            if (!stays) {
+                data[hole] = std::move(data[next]);
+                hole = next;
+            }
+            next = (next + 1 == capacity) ? 0 : next + 1;
         }
-        return std::nullopt;
+        data[hole].template emplace<std::monostate>();
     }
 
-    std::variant<int, std::pair<int, int>> get_slot(const std::string& key) const override {
-        if (this->collision_type == "Chain") {
-            int hash_key = this->hashing(key);
-            for (size_t idx = 0; idx < this->chain_data[hash_key].size(); ++idx) {
-                if (this->chain_data[hash_key][idx].first == key) {
-                    return std::pair<int, int>{hash_key, static_cast<int>(idx)};
+    template <typename F>
+    void for_each_entry(F&& f) const {
+        auto visit_storage = [&](const std::vector<Bucket>& storage) {
+            for (const auto& bucket : storage) {
+                if constexpr (Probing::chained) {
+                    for (const auto& slot : bucket) {
+                        f(slot.kv);
+                    }
+                } else if (const Slot* slot = full(bucket)) {
+                    f(slot->kv);
                 }
             }
-            return std::pair<int, int>{hash_key, -1};
-        } else if (this->collision_type == "Linear") {
-            int hash_key = this->hashing(key);
-            while (this->linear_double_data[hash_key].has_value()) {
-                if (this->linear_double_data[hash_key]->first == key) {
-                    return hash_key;
+        };
+        visit_storage(data);
+        if (draining) {
+            visit_storage(draining->data);
+        }
+    }
+
+    // Calls f(index, slot) for every entry of the current storage, then
+    // f(-1, slot) for those still in storage being drained.
+    template <typename F>
+    void for_each_slot(F&& f) const {
+        for (size_t i = 0; i < data.size(); ++i) {
+            if constexpr (Probing::chained) {
+                for (const auto& slot : data[i]) {
+                    f(static_cast<int>(i), slot);
                 }
-                hash_key = (hash_key + 1) % this->capacity;
-            }
-            return hash_key;
-        } else if (this->collision_type == "Double") {
-            int hash_key = this->hashing(key);
-            int step = this->double_hash(key);
-            while (this->linear_double_data[hash_key].has_value()) {
-                if (this->linear_double_data[hash_key]->first == key) {
-                    return hash_key;
+            } else if (const Slot* slot = full(data[i])) {
+                f(static_cast<int>(i), *slot);
+            }
+        }
+        if (draining) {
+            for (const auto& bucket : draining->data) {
+                if constexpr (Probing::chained) {
+                    for (const auto& slot : bucket) {
+                        f(-1, slot);
+                    }
+                } else if (const Slot* slot = full(bucket)) {
+                    f(-1, *slot);
                 }
-                hash_key = (hash_key + step) % this->capacity;
             }
-            return hash_key;
         }
-        throw std::invalid_argument("Invalid collision type");
     }
 
-    std::string to_string() const override {
+    // Slot-by-slot layout of the current storage; while an incremental resize
+    // is running the old storage follows after " || ".
+    template <typename Format>
+    std::string render(Format&& format) const {
+        std::string result = render_storage(data, format);
+        if (draining) {
+            result += " || " + render_storage(draining->data, format);
+        }
+        return result;
+    }
+
+    template <typename Format>
+    std::string render_storage(const std::vector<Bucket>& storage, Format& format) const {
         std::vector<std::string> items;
-        if (this->collision_type == "Linear" || this->collision_type == "Double") {
-            for (const auto& item : this->linear_double_data) {
-                items.push_back(item.has_value() ? "(" + item->first + "," + item->second.to_string() + ")" : "<EMPTY>");
-            }
-        } else if (this->collision_type == "Chain") {
-            for (const auto& bucket : this->chain_data) {
+        for (const auto& bucket : storage) {
+            if constexpr (Probing::chained) {
                 if (bucket.empty()) {
                     items.push_back("<EMPTY>");
                 } else {
                     std::string aggregate;
-                    for (size_t i = 0; i < bucket.size(); ++i) {
-                        aggregate += "(" + bucket[i].first + "," + bucket[i].second.to_string() + ")";
-                        if (i < bucket.size() - 1) aggregate += " ; ";
+                    for (size_t j = 0; j < bucket.size(); ++j) {
+                        aggregate += format(bucket[j].kv);
+                        if (j < bucket.size() - 1) aggregate += " ; ";
                     }
                     items.push_back(aggregate);
                 }
+            } else {
+                const Slot* slot = full(bucket);
+                items.push_back(slot ? format(slot->kv) : "<EMPTY>");
             }
         }
         return join(items, " | ");
     }
 
-private:
-    void insert_util_1(const std::pair<std::string, ValueType>& x) {
-        int hash_key = this->hashing(x.first);
-        while (this->linear_double_data[hash_key].has_value()) {
-            if (this->linear_double_data[hash_key]->first == x.first) {
-                this->linear_double_data[hash_key] = x;
-                return;
-            }
-            hash_key = (hash_key + 1) % this->capacity;
+public:
+    explicit HashTable(const std::vector<int>& params_, HashFunction hash_function_ = HashFunction::Polynomial,
+                       Growth growth_ = Growth::Prime)
+        : HashTableBase(params_, hash_function_, growth_), data(capacity) {
+        if (std::is_same_v<Probing, DoubleProbing> && (params_.size() < 3 || params_[2] <= 0)) {
+            throw std::invalid_argument("Double probing needs params {z, z2, c2, ..., capacity}");
+        }
+    }
+
+    // Position in the current storage. During an incremental resize, keys
+    // that have not been migrated yet report where they would be placed.
+    std::variant<int, std::pair<int, int>> get_slot(std::string_view key) const {
+        uint64_t hash = hash_of(key);
+        if constexpr (Probing::chained) {
+            int hash_key = range(hash);
+            return std::pair<int, int>{hash_key, find_in_bucket(data[hash_key], key, hash)};
+        } else {
+            return probe(data, range, key, hash).index;
+        }
+    }
+
+    // Returns whether key was present. Once tombstones fill a quarter of the
+    // slots, the storage is rebuilt at the same capacity to clear them.
+    bool erase(std::string_view key) {
+        uint64_t hash = hash_of(key);
+        bool erased = erase_in(data, range, key, hash, true) ||
+                      (draining && erase_in(draining->data, draining->slots, key, hash, false));
+        if (!erased) return false;
+        size--;
+        if (tombstones * 4 >= capacity) {
+            resize(capacity);
         }
-        this->linear_double_data[hash_key] = x;
-        this->size++;
+        return true;
     }
 
-    void insert_util_2(const std::pair<std::string, ValueType>& x) {
-        int hash_key = this->hashing(x.first);
-        int step = this->double_hash(x.first);
-        while (this->linear_double_data[hash_key].has_value()) {
-            if (this->linear_double_data[hash_key]->first == x.first) {
-                this->linear_double_data[hash_key] = x;
-                return;
+    TableStats stats() const {
+        TableStats result = HashTableBase::stats();
+        if constexpr (Probing::chained) {
+            for (const auto& bucket : data) {
+                if (bucket.size() >= result.chain_lengths.size()) {
+                    result.chain_lengths.resize(bucket.size() + 1);
+                }
+                result.chain_lengths[bucket.size()]++;
             }
-            hash_key = (hash_key + step) % this->capacity;
         }
-        this->linear_double_data[hash_key] = x;
-        this->size++;
+        return result;
+    }
+
+    bool is_rehashing() const {
+        return draining.has_value();
+    }
+
+    void finish_rehash() {
+        if (draining) {
+            migrate(draining->slots.size());
+        }
+    }
+};
+
+// Control bytes of a Swiss table: EMPTY and DELETED have the sign bit set, a
+// full slot stores the low 7 bits of its hash. Slots are scanned 16 at a
+// time, with SSE2 when available.
+namespace SwissGroup
+{
+    constexpr int WIDTH = 16;
+    constexpr int8_t EMPTY = -128;
+    constexpr int8_t DELETED = -2;
+
+    // Bit i is set when ctrl[i] == h2.
+    inline uint32_t match(const int8_t* ctrl, int8_t h2)
+    {
+#if defined(__SSE2__)
+        __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), group)));
+#else
+        uint32_t mask = 0;
+        for (int i = 0; i < WIDTH; ++i)
+        {
+            if (ctrl[i] == h2) mask |= 1u << i;
+        }
+        return mask;
+#endif
+    }
+
+    inline uint32_t match_empty(const int8_t* ctrl)
+    {
+        return match(ctrl, EMPTY);
+    }
+
+    // Bit i is set when slot i is EMPTY or DELETED.
+    inline uint32_t match_free(const int8_t* ctrl)
+    {
+#if defined(__SSE2__)
+        __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+        return static_cast<uint32_t>(_mm_movemask_epi8(group));
+#else
+        uint32_t mask = 0;
+        for (int i = 0; i < WIDTH; ++i)
+        {
+            if (ctrl[i] < 0) mask |= 1u << i;
+        }
+        return mask;
+#endif
+    }
+
+    inline int lowest(uint32_t mask)
+    {
+#if defined(__GNUC__)
+        return __builtin_ctz(mask);
+#else
+        int i = 0;
+        while (!(mask & 1u))
+        {
+            mask >>= 1;
+            ++i;
+        }
+        return i;
+#endif
+    }
+}
+
+// Swiss table layout: a one-byte control array next to a dense slot array.
+// The capacity is rounded up to a power of two number of 16-slot groups,
+// probed in triangular order. A probe reads one control group and only
+// touches slots whose 7 hash bits match, so most misses never load a key.
+// Resizes always run in a single pass.
+template <typename ValueType, typename Key>
+class HashTable<ValueType, SwissProbing, Key> : public HashTableBase {
+    template <typename>
+    friend class FrozenTable;
+
+protected:
+    using Entry = typename EntryOf<Key, ValueType>::type;
+
+    struct Slot {
+        uint64_t hash;
+        Entry kv;
+    };
+
+    std::vector<int8_t> ctrl;
+    Slot* slots;
+
+    static int round_capacity(int requested) {
+        int groups = 1;
+        while (groups * SwissGroup::WIDTH < requested) {
+            groups *= 2;
+        }
+        return groups * SwissGroup::WIDTH;
+    }
+
+    // Polynomial hashes of short keys only fill the low bits, so they are
+    // mixed before being split into a group index and 7 control bits.
+    uint64_t spread(uint64_t hash) const {
+        return hash_function == HashFunction::Fast ? hash : FastHash::mix(hash, FastHash::SECRET2);
+    }
+
+    static int8_t h2(uint64_t spread_hash) {
+        return static_cast<int8_t>(spread_hash & 0x7F);
+    }
+
+    int first_group(uint64_t spread_hash) const {
+        return static_cast<int>((spread_hash >> 7) & static_cast<uint64_t>(capacity / SwissGroup::WIDTH - 1));
+    }
+
+    int next_group(int group, int& step) const {
+        return (group + ++step) & (capacity / SwissGroup::WIDTH - 1);
     }
 
-    void insert_util_3(const std::pair<std::string, ValueType>& x) {
-        int hash_key = this->hashing(x.first);
-        for (size_t i = 0; i < this->chain_data[hash_key].size(); ++i) {
-            if (this->chain_data[hash_key][i].first == x.first) {
-                this->chain_data[hash_key][i] = x;
-                return;
+    int find_index(std::string_view key, uint64_t hash) const {
+        uint64_t spread_hash = spread(hash);
+        int8_t tag = h2(spread_hash);
+        int step = 0;
+        int length = 1;
+        for (int group = first_group(spread_hash);; group = next_group(group, step), length++) {
+            const int8_t* group_ctrl = ctrl.data() + group * SwissGroup::WIDTH;
+            for (uint32_t mask = SwissGroup::match(group_ctrl, tag); mask != 0; mask &= mask - 1) {
+                int index = group * SwissGroup::WIDTH + SwissGroup::lowest(mask);
+                if (slots[index].hash == hash && this->same_key(slots[index].kv.first, key)) {
+                    this->count_probe(true, length);
+                    return index;
+                }
+            }
+            if (SwissGroup::match_empty(group_ctrl) != 0) {
+                this->count_probe(false, length);
+                return -1;
             }
         }
-        this->chain_data[hash_key].push_back(x);
-        this->size++;
     }
 
-    std::optional<ValueType> search_util_1(const std::string& key) const {
-        int hash_key = this->hashing(key);
-        while (this->linear_double_data[hash_key].has_value()) {
-            if (this->linear_double_data[hash_key]->first == key) {
-                return this->linear_double_data[hash_key]->second;
+    // First EMPTY or DELETED slot on the probe sequence of hash.
+    int free_index(uint64_t hash) const {
+        uint64_t spread_hash = spread(hash);
+        int step = 0;
+        for (int group = first_group(spread_hash);; group = next_group(group, step)) {
+            uint32_t mask = SwissGroup::match_free(ctrl.data() + group * SwissGroup::WIDTH);
+            if (mask != 0) {
+                return group * SwissGroup::WIDTH + SwissGroup::lowest(mask);
             }
-            hash_key = (hash_key + 1) % this->capacity;
         }
-        return std::nullopt;
     }
 
-    std::optional<ValueType> search_util_2(const std::string& key) const {
-        int hash_key = this->hashing(key);
-        int step = this->double_hash(key);
-        while (this->linear_double_data[hash_key].has_value()) {
-            if (this->linear_double_data[hash_key]->first == key) {
-                return this->linear_double_data[hash_key]->second;
+    Slot& construct_at(int index, Slot&& slot) {
+        if (ctrl[index] == SwissGroup::DELETED) tombstones--;
+        ctrl[index] = h2(spread(slot.hash));
+        return *new (&slots[index]) Slot(std::move(slot));
+    }
+
+    static Slot* allocate(int n) {
+        return std::allocator<Slot>().allocate(n);
+    }
+
+    void release() {
+        if (slots == nullptr) return;
+        for (size_t i = 0; i < ctrl.size(); ++i) {
+            if (ctrl[i] >= 0) slots[i].~Slot();
+        }
+        std::allocator<Slot>().deallocate(slots, ctrl.size());
+        slots = nullptr;
+    }
+
+    const Entry* locate(std::string_view key) const {
+        int index = find_index(key, hash_of(key));
+        return index >= 0 ? &slots[index].kv : nullptr;
+    }
+
+    // As in the primary template, in three rounds per group: prefetch the
+    // first control group of every key, then the slot its tag first matches,
+    // then probe.
+    template <typename Out>
+    void locate_batch(const std::string_view* keys, size_t n, Out&& out) const {
+        uint64_t hashes[BATCH];
+        for (size_t first = 0; first < n; first += BATCH) {
+            size_t count = std::min(BATCH, n - first);
+            for (size_t i = 0; i < count; ++i) {
+                hashes[i] = hash_of(keys[first + i]);
+                prefetch(ctrl.data() + first_group(spread(hashes[i])) * SwissGroup::WIDTH);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                uint64_t spread_hash = spread(hashes[i]);
+                int group = first_group(spread_hash);
+                uint32_t mask = SwissGroup::match(ctrl.data() + group * SwissGroup::WIDTH, h2(spread_hash));
+                if (mask != 0) {
+                    prefetch(&slots[group * SwissGroup::WIDTH + SwissGroup::lowest(mask)]);
+                }
+            }
+            for (size_t i = 0; i < count; ++i) {
+                int index = find_index(keys[first + i], hashes[i]);
+                out(first + i, index >= 0 ? &slots[index].kv : nullptr);
             }
-            hash_key = (hash_key + step) % this->capacity;
         }
-        return std::nullopt;
     }
 
-    std::optional<ValueType> search_util_3(const std::string& key) const {
-        int hash_key = this->hashing(key);
-        for (const auto& kv : this->chain_data[hash_key]) {
-            if (kv.first == key) {
-                return kv.second;
+    Entry* locate(std::string_view key) {
+        return const_cast<Entry*>(std::as_const(*this).locate(key));
+    }
+
+    template <typename Make>
+    std::pair<Entry*, bool> find_or_insert(std::string_view key, Make&& make) {
+        uint64_t hash = hash_of(key);
+        int index = find_index(key, hash);
+        if (index >= 0) return {&slots[index].kv, false};
+        Slot& slot = construct_at(free_index(hash), Slot{hash, make()});
+        size++;
+        return {&slot.kv, true};
+    }
+
+    template <typename E>
+    std::pair<Entry*, bool> emplace(E&& x) {
+        return find_or_insert(x.first, [&]() { return Entry(std::forward<E>(x)); });
+    }
+
+    void resize(int new_capacity) {
+        this->count_rehash();
+        RehashTimer timer(*this);
+        std::vector<int8_t> old_ctrl = std::move(ctrl);
+        Slot* old_slots = slots;
+        capacity = round_capacity(new_capacity);
+        tombstones = 0;
+        ctrl.assign(capacity, SwissGroup::EMPTY);
+        slots = allocate(capacity);
+        for (size_t i = 0; i < old_ctrl.size(); ++i) {
+            if (old_ctrl[i] >= 0) {
+                construct_at(free_index(old_slots[i].hash), std::move(old_slots[i]));
+                old_slots[i].~Slot();
+                this->count_moved(sizeof(Slot));
             }
         }
-        return std::nullopt;
+        std::allocator<Slot>().deallocate(old_slots, old_ctrl.size());
     }
 
-    std::string join(const std::vector<std::string>& items, const std::string& delimiter) const {
-        std::string result;
-        for (size_t i = 0; i < items.size(); ++i) {
-            result += items[i];
-            if (i < items.size() - 1) result += delimiter;
+    void begin_resize(int new_capacity) {
+        resize(new_capacity);
+    }
+
+    void migrate(int) {}
+
+    template <typename F>
+    void for_each_entry(F&& f) const {
+        for (size_t i = 0; i < ctrl.size(); ++i) {
+            if (ctrl[i] >= 0) f(slots[i].kv);
         }
-        return result;
+    }
+
+    template <typename F>
+    void for_each_slot(F&& f) const {
+        for (size_t i = 0; i < ctrl.size(); ++i) {
+            if (ctrl[i] >= 0) f(static_cast<int>(i), slots[i]);
+        }
+    }
+
+    template <typename Format>
+    std::string render(Format&& format) const {
+        std::vector<std::string> items;
+        for (size_t i = 0; i < ctrl.size(); ++i) {
+            items.push_back(ctrl[i] >= 0 ? format(slots[i].kv) : "<EMPTY>");
+        }
+        return join(items, " | ");
+    }
+
+public:
+    explicit HashTable(const std::vector<int>& params_, HashFunction hash_function_ = HashFunction::Polynomial,
+                       Growth growth_ = Growth::Prime)
+        : HashTableBase(params_, hash_function_, growth_) {
+        capacity = round_capacity(capacity);
+        ctrl.assign(capacity, SwissGroup::EMPTY);
+        slots = allocate(capacity);
+    }
+
+    HashTable(const HashTable& other)
+        : HashTableBase(other), ctrl(other.ctrl), slots(allocate(other.capacity)) {
+        for (size_t i = 0; i < ctrl.size(); ++i) {
+            if (ctrl[i] >= 0) new (&slots[i]) Slot(other.slots[i]);
+        }
+    }
+
+    HashTable(HashTable&& other) noexcept
+        : HashTableBase(std::move(other)), ctrl(std::move(other.ctrl)), slots(std::exchange(other.slots, nullptr)) {
+        other.ctrl.clear();
+    }
+
+    HashTable& operator=(HashTable other) noexcept {
+        std::swap(static_cast<HashTableBase&>(*this), static_cast<HashTableBase&>(other));
+        std::swap(ctrl, other.ctrl);
+        std::swap(slots, other.slots);
+        return *this;
+    }
+
+    ~HashTable() {
+        release();
+    }
+
+    std::variant<int, std::pair<int, int>> get_slot(std::string_view key) const {
+        uint64_t hash = hash_of(key);
+        int index = find_index(key, hash);
+        return index >= 0 ? index : free_index(hash);
+    }
+
+    // A slot whose group still has an EMPTY byte can become EMPTY itself:
+    // any probe reaching that group stops there anyway. Otherwise it becomes
+    // DELETED, and a quarter of DELETED slots triggers an in-place rebuild.
+    bool erase(std::string_view key) {
+        int index = find_index(key, hash_of(key));
+        if (index < 0) return false;
+        slots[index].~Slot();
+        int group = index / SwissGroup::WIDTH;
+        if (SwissGroup::match_empty(ctrl.data() + group * SwissGroup::WIDTH) != 0) {
+            ctrl[index] = SwissGroup::EMPTY;
+        } else {
+            ctrl[index] = SwissGroup::DELETED;
+            tombstones++;
+        }
+        size--;
+        if (tombstones * 4 >= capacity) {
+            resize(capacity);
+        }
+        return true;
+    }
+
+    bool is_rehashing() const {
+        return false;
+    }
+
+    void finish_rehash() {}
+};
+
+// Robin Hood hashing: linear probing where each slot records how far its
+// entry sits from its home slot. An insert takes over the slot of any entry
+// nearer its home than the new one is and carries that entry on, which keeps
+// probe lengths short at high loads, and a miss stops at the first entry
+// nearer its home than the key would be. Erase shifts the rest of the
+// cluster back, so there are no tombstones. Resizes run in a single pass.
+template <typename ValueType, typename Key>
+class HashTable<ValueType, RobinHoodProbing, Key> : public HashTableBase {
+    template <typename>
+    friend class FrozenTable;
+
+protected:
+    using Entry = typename EntryOf<Key, ValueType>::type;
+
+    struct Slot {
+        uint64_t hash;
+        Entry kv;
+    };
+
+    // Probe distance plus one; 0 marks an empty slot.
+    std::vector<uint32_t> distances;
+    Slot* slots;
+
+    int next(int index) const {
+        return index + 1 == capacity ? 0 : index + 1;
+    }
+
+    int find_index(std::string_view key, uint64_t hash) const {
+        int index = range(hash);
+        for (uint32_t distance = 1;; ++distance) {
+            if (distances[index] < distance) {
+                this->count_probe(false, static_cast<int>(distance));
+                return -1;
+            }
+            if (slots[index].hash == hash && this->same_key(slots[index].kv.first, key)) {
+                this->count_probe(true, static_cast<int>(distance));
+                return index;
+            }
+            index = next(index);
+        }
+    }
+
+    // Where a key with this hash would be inserted.
+    int insert_index(uint64_t hash) const {
+        int index = range(hash);
+        for (uint32_t distance = 1; distances[index] >= distance; ++distance) {
+            index = next(index);
+        }
+        return index;
+    }
+
+    // Stores a slot whose key is absent and returns the index it landed in.
+    int place(Slot&& slot) {
+        int index = range(slot.hash);
+        uint32_t distance = 1;
+        int landed = -1;
+        for (; distances[index] != 0; index = next(index), ++distance) {
+            if (distances[index] < distance) {
+                std::swap(slots[index], slot);
+                std::swap(distances[index], distance);
+                if (landed < 0) landed = index;
+            }
+        }
+        new (&slots[index]) Slot(std::move(slot));
+        distances[index] = distance;
+        return landed < 0 ? index : landed;
+    }
+
+    static Slot* allocate(int n) {
+        return std::allocator<Slot>().allocate(n);
+    }
+
+    void release() {
+        if (slots == nullptr) return;
+        for (size_t i = 0; i < distances.size(); ++i) {
+            if (distances[i] != 0) slots[i].~Slot();
+        }
+        std::allocator<Slot>().deallocate(slots, distances.size());
+        slots = nullptr;
+    }
+
+    const Entry* locate(std::string_view key) const {
+        int index = find_index(key, hash_of(key));
+        return index >= 0 ? &slots[index].kv : nullptr;
+    }
+
+    // As in the primary template: a group of keys is hashed and their home
+    // slots prefetched before the first is probed.
+    template <typename Out>
+    void locate_batch(const std::string_view* keys, size_t n, Out&& out) const {
+        uint64_t hashes[BATCH];
+        for (size_t first = 0; first < n; first += BATCH) {
+            size_t count = std::min(BATCH, n - first);
+            for (size_t i = 0; i < count; ++i) {
+                hashes[i] = hash_of(keys[first + i]);
+                int home = range(hashes[i]);
+                prefetch(&distances[home]);
+                prefetch(&slots[home]);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                int index = find_index(keys[first + i], hashes[i]);
+                out(first + i, index >= 0 ? &slots[index].kv : nullptr);
+            }
+        }
+    }
+
+    Entry* locate(std::string_view key) {
+        return const_cast<Entry*>(std::as_const(*this).locate(key));
+    }
+
+    template <typename Make>
+    std::pair<Entry*, bool> find_or_insert(std::string_view key, Make&& make) {
+        uint64_t hash = hash_of(key);
+        int index = find_index(key, hash);
+        if (index >= 0) return {&slots[index].kv, false};
+        index = place(Slot{hash, make()});
+        size++;
+        return {&slots[index].kv, true};
+    }
+
+    template <typename E>
+    std::pair<Entry*, bool> emplace(E&& x) {
+        return find_or_insert(x.first, [&]() { return Entry(std::forward<E>(x)); });
+    }
+
+    void resize(int new_capacity) {
+        this->count_rehash();
+        RehashTimer timer(*this);
+        std::vector<uint32_t> old_distances = std::move(distances);
+        Slot* old_slots = slots;
+        set_capacity(new_capacity);
+        distances.assign(capacity, 0);
+        slots = allocate(capacity);
+        for (size_t i = 0; i < old_distances.size(); ++i) {
+            if (old_distances[i] != 0) {
+                place(std::move(old_slots[i]));
+                old_slots[i].~Slot();
+                this->count_moved(sizeof(Slot));
+            }
+        }
+        std::allocator<Slot>().deallocate(old_slots, old_distances.size());
+    }
+
+    void begin_resize(int new_capacity) {
+        resize(new_capacity);
+    }
+
+    void migrate(int) {}
+
+    template <typename F>
+    void for_each_entry(F&& f) const {
+        for (size_t i = 0; i < distances.size(); ++i) {
+            if (distances[i] != 0) f(slots[i].kv);
+        }
+    }
+
+    template <typename F>
+    void for_each_slot(F&& f) const {
+        for (size_t i = 0; i < distances.size(); ++i) {
+            if (distances[i] != 0) f(static_cast<int>(i), slots[i]);
+        }
+    }
+
+    template <typename Format>
+    std::string render(Format&& format) const {
+        std::vector<std::string> items;
+        for (size_t i = 0; i < distances.size(); ++i) {
+            items.push_back(distances[i] != 0 ? format(slots[i].kv) : "<EMPTY>");
+        }
+        return join(items, " | ");
+    }
+
+public:
+    explicit HashTable(const std::vector<int>& params_, HashFunction hash_function_ = HashFunction::Polynomial,
+                       Growth growth_ = Growth::Prime)
+        : HashTableBase(params_, hash_function_, growth_), distances(capacity, 0), slots(allocate(capacity)) {}
+
+    HashTable(const HashTable& other)
+        : HashTableBase(other), distances(other.distances), slots(allocate(other.capacity)) {
+        for (size_t i = 0; i < distances.size(); ++i) {
+            if (distances[i] != 0) new (&slots[i]) Slot(other.slots[i]);
+        }
+    }
+
+    HashTable(HashTable&& other) noexcept
+        : HashTableBase(std::move(other)), distances(std::move(other.distances)), slots(std::exchange(other.slots, nullptr)) {
+        other.distances.clear();
+    }
+
+    HashTable& operator=(HashTable other) noexcept {
+        std::swap(static_cast<HashTableBase&>(*this), static_cast<HashTableBase&>(other));
+        std::swap(distances, other.distances);
+        std::swap(slots, other.slots);
+        return *this;
+    }
+
+    ~HashTable() {
+        release();
+    }
+
+    std::variant<int, std::pair<int, int>> get_slot(std::string_view key) const {
+        uint64_t hash = hash_of(key);
+        int index = find_index(key, hash);
+        return index >= 0 ? index : insert_index(hash);
+    }
+
+    // Pulls each following entry of the cluster back one slot until one is
+    // already at its home slot.
+    bool erase(std::string_view key) {
+        int hole = find_index(key, hash_of(key));
+        if (hole < 0) return false;
+        slots[hole].~Slot();
+        for (int index = next(hole); distances[index] > 1; index = next(index)) {
+            new (&slots[hole]) Slot(std::move(slots[index]));
+            slots[index].~Slot();
+            distances[hole] = distances[index] - 1;
+            hole = index;
+        }
+        distances[hole] = 0;
+        size--;
+        return true;
+    }
+
+    bool is_rehashing() const {
+        return false;
+    }
+
+    void finish_rehash() {}
+};
+
+// Read-only copy of a table built by freeze(), in CSR form: the entries of
+// bucket b are entries[offsets[b] .. offsets[b + 1]), every key is packed
+// into one blob and the values sit in one array in entry order. A frozen
+// Chain table keeps the source's buckets and chain order; open-addressing
+// layouts are regrouped into one bucket per entry. Keys hash and compare
+// exactly as in the source table.
+template <typename ValueType>
+class FrozenTable : public HashTableBase {
+protected:
+    struct Entry {
+        uint64_t hash;
+        uint32_t key_offset;
+        uint32_t key_length;
+        // What the source's get_slot reported for the key: its slot, or its
+        // place in its chain. A key still being migrated by an incremental
+        // resize has the slot it would move to, or -1 in a chain.
+        int slot;
+    };
+
+    bool chained;
+    SlotRange buckets;
+    std::vector<uint32_t> offsets;
+    std::vector<Entry> entries;
+    std::string blob;
+    std::vector<ValueType> values;
+
+    template <typename Table, typename Convert>
+    FrozenTable(const Table& source, bool chained_, Convert&& convert) : HashTableBase(source), chained(chained_) {
+        int count = chained ? capacity : std::max(size, 1);
+        buckets = chained ? range : SlotRange(count, false);
+        std::vector<std::pair<int, const typename Table::Slot*>> slots;
+        slots.reserve(size);
+        source.for_each_slot([&](int index, const auto& slot) { slots.emplace_back(index, &slot); });
+
+        offsets.assign(count + 1, 0);
+        size_t blob_size = 0;
+        for (const auto& [index, slot] : slots) {
+            offsets[buckets(slot->hash) + 1]++;
+            blob_size += slot->kv.first.size();
+        }
+        if (blob_size > UINT32_MAX) {
+            throw std::invalid_argument("Keys too large to freeze");
+        }
+        for (int b = 0; b < count; ++b) {
+            offsets[b + 1] += offsets[b];
+        }
+        std::vector<uint32_t> order(slots.size());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t k = 0; k < slots.size(); ++k) {
+            order[fill[buckets(slots[k].second->hash)]++] = static_cast<uint32_t>(k);
+        }
+
+        entries.reserve(slots.size());
+        blob.reserve(blob_size);
+        // A chain's current entries come first in their bucket, in chain
+        // order, so their place in it is their place in the source chain.
+        for (uint32_t k : order) {
+            const auto& [index, slot] = slots[k];
+            std::string_view key = slot->kv.first;
+            int recorded = index;
+            if (chained) {
+                recorded = index < 0 ? -1 : static_cast<int>(entries.size() - offsets[buckets(slot->hash)]);
+            } else if (index < 0) {
+                recorded = std::get<int>(source.get_slot(key));
+            }
+            entries.push_back(Entry{slot->hash, static_cast<uint32_t>(blob.size()), static_cast<uint32_t>(key.size()), recorded});
+            blob.append(key);
+            if constexpr (!std::is_same_v<ValueType, KeyOnly>) {
+                values.push_back(convert(slot->kv.second));
+            }
+        }
+    }
+
+    std::string_view key_of(const Entry& entry) const {
+        return std::string_view(blob.data() + entry.key_offset, entry.key_length);
+    }
+
+    // Index into entries, or -1.
+    int find_index(std::string_view key, uint64_t hash) const {
+        int bucket = buckets(hash);
+        uint32_t first = offsets[bucket];
+        for (uint32_t i = first; i < offsets[bucket + 1]; ++i) {
+            if (entries[i].hash == hash && this->same_key(key_of(entries[i]), key)) {
+                this->count_probe(true, static_cast<int>(i - first) + 1);
+                return static_cast<int>(i);
+            }
+        }
+        this->count_probe(false, static_cast<int>(offsets[bucket + 1] - first));
+        return -1;
+    }
+
+    // Calls out(i, index into entries or -1) for every keys[i], prefetching
+    // the offsets and then the first entry of a group's buckets before
+    // probing, as HashTable::locate_batch() does.
+    template <typename Out>
+    void locate_batch(const std::string_view* keys, size_t n, Out&& out) const {
+        uint64_t hashes[BATCH];
+        for (size_t first = 0; first < n; first += BATCH) {
+            size_t count = std::min(BATCH, n - first);
+            for (size_t i = 0; i < count; ++i) {
+                hashes[i] = hash_of(keys[first + i]);
+                prefetch(&offsets[buckets(hashes[i])]);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                prefetch(entries.data() + offsets[buckets(hashes[i])]);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                out(first + i, find_index(keys[first + i], hashes[i]));
+            }
+        }
+    }
+
+public:
+    // What the source's get_slot reported for the key when it was frozen.
+    // Absent keys report {bucket, -1} for Chain, as the source does, and -1
+    // for open addressing, which has no insertion point once frozen.
+    std::variant<int, std::pair<int, int>> get_slot(std::string_view key) const {
+        uint64_t hash = hash_of(key);
+        int index = find_index(key, hash);
+        if (chained) {
+            return std::pair<int, int>{buckets(hash), index >= 0 ? entries[index].slot : -1};
+        }
+        return index >= 0 ? entries[index].slot : -1;
+    }
+
+    bool contains(std::string_view key) const {
+        return find_index(key, hash_of(key)) >= 0;
+    }
+
+    std::vector<std::string_view> views() const {
+        std::vector<std::string_view> items;
+        items.reserve(entries.size());
+        for (const Entry& entry : entries) {
+            items.push_back(key_of(entry));
+        }
+        return items;
+    }
+
+    std::vector<std::string> keys() const {
+        std::vector<std::string> items;
+        items.reserve(entries.size());
+        for (const Entry& entry : entries) {
+            items.emplace_back(key_of(entry));
+        }
+        return items;
+    }
+
+    // Bytes held by the frozen layout. Values count sizeof(ValueType) each,
+    // not what they own.
+    size_t memory_bytes() const {
+        return sizeof(*this) + offsets.capacity() * sizeof(uint32_t) +
+               entries.capacity() * sizeof(Entry) + blob.capacity() + values.capacity() * sizeof(ValueType);
+    }
+};
+
+class FrozenSet : public FrozenTable<KeyOnly> {
+public:
+    template <typename Table>
+    FrozenSet(const Table& source, bool chained) : FrozenTable<KeyOnly>(source, chained, [](const auto&) { return KeyOnly{}; }) {}
+
+    std::optional<std::string> find(std::string_view key) const {
+        return contains(key) ? std::optional<std::string>(key) : std::nullopt;
+    }
+
+    void find_batch(const std::vector<std::string_view>& keys, std::vector<bool>& found) const {
+        found.assign(keys.size(), false);
+        locate_batch(keys.data(), keys.size(), [&](size_t i, int index) { found[i] = index >= 0; });
+    }
+};
+
+template <typename ValueType>
+class FrozenMap : public FrozenTable<ValueType> {
+public:
+    // Each value is stored as convert(value).
+    template <typename Table, typename Convert>
+    FrozenMap(const Table& source, bool chained, Convert&& convert)
+        : FrozenTable<ValueType>(source, chained, std::forward<Convert>(convert)) {}
+
+    const ValueType* find_ptr(std::string_view key) const {
+        int index = this->find_index(key, this->hash_of(key));
+        return index >= 0 ? &this->values[index] : nullptr;
+    }
+
+    std::optional<ValueType> find(std::string_view key) const {
+        const ValueType* value = find_ptr(key);
+        return value ? std::optional<ValueType>(*value) : std::nullopt;
+    }
+
+    const ValueType& find_ref(std::string_view key) const {
+        const ValueType* value = find_ptr(key);
+        if (value == nullptr) {
+            throw std::invalid_argument("Key not found");
+        }
+        return *value;
+    }
+
+    void find_batch(const std::vector<std::string_view>& keys, std::vector<const ValueType*>& out) const {
+        out.assign(keys.size(), nullptr);
+        this->locate_batch(keys.data(), keys.size(), [&](size_t i, int index) {
+            out[i] = index >= 0 ? &this->values[index] : nullptr;
+        });
+    }
+};
+
+template <typename Probing, typename Key = std::string>
+class BasicHashSet : public HashTable<KeyOnly, Probing, Key> {
+public:
+    explicit BasicHashSet(const std::vector<int>& params, HashFunction hash_function = HashFunction::Polynomial,
+                          Growth growth = Growth::Prime)
+        : HashTable<KeyOnly, Probing, Key>(params, hash_function, growth) {}
+
+    // The pair form predates key-only storage; only x.first is kept.
+    void insert(const std::pair<std::string, std::string>& x) {
+        static_assert(std::is_same_v<Key, std::string>, "a view-keyed set cannot take ownership of a key");
+        insert(x.first);
+    }
+
+    // Returns whether key was added.
+    bool insert(const Key& key) {
+        return this->find_or_insert(key, [&]() { return typename HashTable<KeyOnly, Probing, Key>::Entry{key}; }).second;
+    }
+
+    bool contains(std::string_view key) const {
+        return this->locate(key) != nullptr;
+    }
+
+    std::optional<std::string> find(std::string_view key) const {
+        return contains(key) ? std::optional<std::string>(key) : std::nullopt;
+    }
+
+    // found[i] is whether keys[i] is in the set; see locate_batch().
+    void find_batch(const std::vector<std::string_view>& keys, std::vector<bool>& found) const {
+        found.assign(keys.size(), false);
+        this->locate_batch(keys.data(), keys.size(), [&](size_t i, const auto* kv) { found[i] = kv != nullptr; });
+    }
+
+    std::string to_string() const {
+        return this->render([](const auto& kv) { return std::string(kv.first); });
+    }
+
+    std::vector<std::string> keys() const {
+        std::vector<std::string> items;
+        items.reserve(this->size);
+        this->for_each_entry([&](const auto& kv) { items.emplace_back(kv.first); });
+        return items;
+    }
+
+    // The stored keys themselves; valid until the set is next modified.
+    std::vector<std::string_view> views() const {
+        std::vector<std::string_view> items;
+        items.reserve(this->size);
+        this->for_each_entry([&](const auto& kv) { items.emplace_back(kv.first); });
+        return items;
+    }
+
+    FrozenSet freeze() const {
+        return FrozenSet(*this, Probing::chained);
+    }
+};
+
+template <typename ValueType, typename Probing>
+class BasicHashMap : public HashTable<ValueType, Probing> {
+public:
+    explicit BasicHashMap(const std::vector<int>& params, HashFunction hash_function = HashFunction::Polynomial,
+                          Growth growth = Growth::Prime)
+        : HashTable<ValueType, Probing>(params, hash_function, growth) {}
+
+    void insert(const std::pair<std::string, ValueType>& x) {
+        auto [entry, inserted] = this->emplace(x);
+        if (!inserted) entry->second = x.second;
+    }
+
+    void insert(std::pair<std::string, ValueType>&& x) {
+        auto [entry, inserted] = this->emplace(std::move(x));
+        if (!inserted) entry->second = std::move(x.second);
+    }
+
+    bool contains(std::string_view key) const {
+        return this->locate(key) != nullptr;
+    }
+
+    // Copies the value; find_ptr() and find_ref() do not.
+    std::optional<ValueType> find(std::string_view key) const {
+        const ValueType* value = find_ptr(key);
+        return value ? std::optional<ValueType>(*value) : std::nullopt;
+    }
+
+    const ValueType* find_ptr(std::string_view key) const {
+        const auto* kv = this->locate(key);
+        return kv ? &kv->second : nullptr;
+    }
+
+    const ValueType& find_ref(std::string_view key) const {
+        const ValueType* value = find_ptr(key);
+        if (value == nullptr) {
+            throw std::invalid_argument("Key not found");
+        }
+        return *value;
+    }
+
+    // out[i] is find_ptr(keys[i]); see locate_batch().
+    void find_batch(const std::vector<std::string_view>& keys, std::vector<const ValueType*>& out) const {
+        out.assign(keys.size(), nullptr);
+        this->locate_batch(keys.data(), keys.size(), [&](size_t i, const auto* kv) { out[i] = kv ? &kv->second : nullptr; });
+    }
+
+    std::string to_string() const {
+        return this->render([](const auto& kv) { return "(" + kv.first + "," + kv.second.to_string() + ")"; });
+    }
+
+    FrozenMap<ValueType> freeze() const {
+        return freeze([](const ValueType& value) { return value; });
+    }
+
+    // Stores convert(value) for each value, e.g. to freeze a map of sets.
+    template <typename Convert>
+    auto freeze(Convert&& convert) const {
+        using Frozen = std::decay_t<std::invoke_result_t<Convert&, const ValueType&>>;
+        return FrozenMap<Frozen>(*this, Probing::chained, convert);
+    }
+};
+
+// Owning pointer that copies its pointee, so a boxed table copies like one
+// held inline.
+template <typename T>
+class Box {
+private:
+    std::unique_ptr<T> ptr;
+
+public:
+    explicit Box(std::unique_ptr<T> ptr_) : ptr(std::move(ptr_)) {}
+
+    Box(const Box& other) : ptr(other.ptr ? std::make_unique<T>(*other.ptr) : nullptr) {}
+
+    Box(Box&&) noexcept = default;
+
+    Box& operator=(const Box& other) {
+        return *this = Box(other);
+    }
+
+    Box& operator=(Box&&) noexcept = default;
+
+    T& operator*() {
+        return *ptr;
+    }
+
+    const T& operator*() const {
+        return *ptr;
+    }
+};
+
+// Inline holds the table in the variant, which is as large as the largest
+// layout. Boxed holds a Box of the chosen layout only: 16 bytes plus a heap
+// block of that layout's size, at one more indirection per call. Boxed
+// suits the many small tables of a library, such as its per-book sets.
+enum class DispatchStorage {
+    Inline,
+    Boxed
+};
+
+// Picks a specialized table from a collision type name for callers that
+// only know it at run time. Each call costs one std::visit jump; the table
+// behind it has no string compares on its lookup path.
+template <template <typename> class Table, DispatchStorage Storage = DispatchStorage::Inline>
+class CollisionTypeDispatch {
+protected:
+    template <typename Probing>
+    using Held = std::conditional_t<Storage == DispatchStorage::Boxed, Box<Table<Probing>>, Table<Probing>>;
+
+    using Variant = std::variant<Held<LinearProbing>, Held<DoubleProbing>, Held<ChainProbing>, Held<SwissProbing>,
+                                 Held<RobinHoodProbing>>;
+
+    Variant table;
+
+    template <typename Probing, typename... Args>
+    static Variant build(const Args&... args) {
+        if constexpr (Storage == DispatchStorage::Boxed) {
+            return Box<Table<Probing>>(std::make_unique<Table<Probing>>(args...));
+        } else {
+            return Table<Probing>(args...);
+        }
+    }
+
+    template <typename... Args>
+    static Variant make(const std::string& collision_type, const std::vector<int>& params, const Args&... args) {
+        if (collision_type == LinearProbing::name) {
+            return build<LinearProbing>(params, args...);
+        } else if (collision_type == DoubleProbing::name) {
+            return build<DoubleProbing>(params, args...);
+        } else if (collision_type == ChainProbing::name) {
+            return build<ChainProbing>(params, args...);
+        } else if (collision_type == SwissProbing::name) {
+            return build<SwissProbing>(params, args...);
+        } else if (collision_type == RobinHoodProbing::name) {
+            return build<RobinHoodProbing>(params, args...);
+        }
+        throw std::invalid_argument("Invalid collision type");
+    }
+
+    template <typename T>
+    static T& open(T& held) {
+        return held;
+    }
+
+    template <typename T>
+    static T& open(Box<T>& held) {
+        return *held;
+    }
+
+    template <typename T>
+    static const T& open(const Box<T>& held) {
+        return *held;
+    }
+
+    template <typename F>
+    decltype(auto) visit(F&& f) {
+        return std::visit([&](auto& held) -> decltype(auto) { return f(open(held)); }, table);
+    }
+
+    template <typename F>
+    decltype(auto) visit(F&& f) const {
+        return std::visit([&](const auto& held) -> decltype(auto) { return f(open(held)); }, table);
+    }
+
+public:
+    template <typename... Args>
+    CollisionTypeDispatch(const std::string& collision_type, const std::vector<int>& params, const Args&... args)
+        : table(make(collision_type, params, args...)) {}
+
+    std::variant<int, std::pair<int, int>> get_slot(const std::string& key) const {
+        return visit([&](const auto& t) { return t.get_slot(key); });
+    }
+
+    std::string to_string() const {
+        return visit([](const auto& t) { return t.to_string(); });
+    }
+
+    double get_load() const {
+        return visit([](const auto& t) { return t.get_load(); });
+    }
+
+    int get_size() const {
+        return visit([](const auto& t) { return t.get_size(); });
+    }
+
+    int get_capacity() const {
+        return visit([](const auto& t) { return t.get_capacity(); });
+    }
+
+    double get_max_load() const {
+        return visit([](const auto& t) { return t.get_max_load(); });
+    }
+
+    bool is_rehashing() const {
+        return visit([](const auto& t) { return t.is_rehashing(); });
+    }
+
+    TableStats stats() const {
+        return visit([](const auto& t) { return t.stats(); });
+    }
+
+    bool erase(const std::string& key) {
+        return visit([&](auto& t) { return t.erase(key); });
+    }
+
+    void finish_rehash() {
+        visit([](auto& t) { t.finish_rehash(); });
+    }
+};
+
+template <typename Key>
+struct HashSetOf {
+    template <typename Probing>
+    using type = BasicHashSet<Probing, Key>;
+};
+
+class HashSet : public CollisionTypeDispatch<HashSetOf<std::string>::type> {
+public:
+    HashSet(const std::string& collision_type, const std::vector<int>& params, HashFunction hash_function = HashFunction::Polynomial)
+        : CollisionTypeDispatch<HashSetOf<std::string>::type>(collision_type, params, hash_function) {}
+
+    void insert(const std::pair<std::string, std::string>& x) {
+        visit([&](auto& t) { t.insert(x); });
+    }
+
+    bool contains(std::string_view key) const {
+        return visit([&](const auto& t) { return t.contains(key); });
+    }
+
+    std::optional<std::string> find(const std::string& key) const {
+        return visit([&](const auto& t) { return t.find(key); });
+    }
+
+    void find_batch(const std::vector<std::string_view>& keys, std::vector<bool>& found) const {
+        visit([&](const auto& t) { t.find_batch(keys, found); });
+    }
+
+    std::vector<std::string> keys() const {
+        return visit([](const auto& t) { return t.keys(); });
+    }
+
+    FrozenSet freeze() const {
+        return visit([](const auto& t) { return t.freeze(); });
+    }
+};
+
+template <typename ValueType>
+struct HashMapOf {
+    template <typename Probing>
+    using type = BasicHashMap<ValueType, Probing>;
+};
+
+template <typename ValueType>
+class HashMap : public CollisionTypeDispatch<HashMapOf<ValueType>::template type> {
+public:
+    HashMap(const std::string& collision_type, const std::vector<int>& params, HashFunction hash_function = HashFunction::Polynomial)
+        : CollisionTypeDispatch<HashMapOf<ValueType>::template type>(collision_type, params, hash_function) {}
+
+    void insert(const std::pair<std::string, ValueType>& x) {
+        this->visit([&](auto& t) { t.insert(x); });
+    }
+
+    void insert(std::pair<std::string, ValueType>&& x) {
+        this->visit([&](auto& t) { t.insert(std::move(x)); });
+    }
+
+    bool contains(std::string_view key) const {
+        return this->visit([&](const auto& t) { return t.contains(key); });
+    }
+
+    std::optional<ValueType> find(std::string_view key) const {
+        return this->visit([&](const auto& t) { return t.find(key); });
+    }
+
+    const ValueType* find_ptr(std::string_view key) const {
+        return this->visit([&](const auto& t) { return t.find_ptr(key); });
+    }
+
+    const ValueType& find_ref(std::string_view key) const {
+        return this->visit([&](const auto& t) -> const ValueType& { return t.find_ref(key); });
+    }
+
+    void find_batch(const std::vector<std::string_view>& keys, std::vector<const ValueType*>& out) const {
+        this->visit([&](const auto& t) { t.find_batch(keys, out); });
+    }
+
+    FrozenMap<ValueType> freeze() const {
+        return this->visit([](const auto& t) { return t.freeze(); });
+    }
+
+    template <typename Convert>
+    auto freeze(Convert&& convert) const {
+        return this->visit([&](const auto& t) { return t.freeze(convert); });
     }
 };
 
@@ -0,0 +1,575 @@
+#ifndef INVERTED_INDEX_HPP
+#define INVERTED_INDEX_HPP
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <queue>
+#include <optional>
+#include <algorithm>
+#include <stdexcept>
+#include <map>
+#include <cmath>
+#include <limits>
+#include <functional>
+#include "string_pool.hpp"
+#include "dictionary.hpp"
+#include "prefetch.hpp"
+
+// Sorted list of book IDs stored as varint-encoded gaps. Every SKIP_INTERVAL
+// postings a block starts: its first ID is kept uncompressed in the skip table
+// together with the byte offset of the gaps that follow it, so cursors can
+// jump over whole blocks without decoding them. A list may also carry a
+// frequency per posting, as a second varint stream the skip table indexes.
+class PostingList {
+public:
+    static constexpr int SKIP_INTERVAL = 64;
+
+    struct Skip {
+        int doc_id;
+        size_t offset;
+        size_t frequency_offset;
+    };
+
+    class Cursor {
+    private:
+        const PostingList* list;
+        int index;
+        int block;
+        int doc_id;
+        size_t offset;
+        size_t frequency_offset;
+        uint32_t current_frequency;
+
+        void read_frequency() {
+            if (list->weighted()) {
+                current_frequency = read_varint(list->frequencies, frequency_offset);
+            }
+        }
+
+        void enter_block(int b) {
+            block = b;
+            index = b * SKIP_INTERVAL;
+            doc_id = list->skips[b].doc_id;
+            offset = list->skips[b].offset;
+            frequency_offset = list->skips[b].frequency_offset;
+            read_frequency();
+        }
+
+    public:
+        explicit Cursor(const PostingList* list_)
+            : list(list_), index(0), block(0), doc_id(-1), offset(0), frequency_offset(0), current_frequency(1) {
+            if (list->count > 0) {
+                enter_block(0);
+            }
+        }
+
+        bool done() const {
+            return index >= list->count;
+        }
+
+        int doc() const {
+            return doc_id;
+        }
+
+        // 1 when the list has no frequencies.
+        uint32_t frequency() const {
+            return current_frequency;
+        }
+
+        void next() {
+            ++index;
+            if (done()) return;
+            if (index % SKIP_INTERVAL == 0) {
+                enter_block(block + 1);
+            } else {
+                doc_id += static_cast<int>(read_varint(list->bytes, offset));
+                read_frequency();
+            }
+        }
+
+        // Moves to the first posting >= target. Gallops over the skip table to
+        // find the block, then decodes linearly inside it.
+        void advance_to(int target) {
+            if (done() || doc_id >= target) return;
+            int num_blocks = static_cast<int>(list->skips.size());
+            int lo = block;
+            int step = 1;
+            while (block + step < num_blocks && list->skips[block + step].doc_id <= target) {
+                lo = block + step;
+                step *= 2;
+            }
+            int hi = std::min(block + step, num_blocks);
+            while (hi - lo > 1) {
+                int mid = lo + (hi - lo) / 2;
+                if (list->skips[mid].doc_id <= target) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+            if (lo > block) {
+                enter_block(lo);
+            }
+            while (!done() && doc_id < target) {
+                next();
+            }
+        }
+    };
+
+    void add(int doc_id) {
+        if (weighted()) {
+            throw std::invalid_argument("Postings of this word need a frequency");
+        }
+        append(doc_id);
+    }
+
+    // Every posting of a list with frequencies must have one, at least 1.
+    void add(int doc_id, uint32_t frequency) {
+        if (frequency == 0 || (count > 0 && !weighted())) {
+            throw std::invalid_argument("Invalid posting frequency");
+        }
+        append(doc_id);
+        write_varint(frequencies, frequency);
+        max_frequency = std::max(max_frequency, frequency);
+    }
+
+    int size() const {
+        return count;
+    }
+
+    bool weighted() const {
+        return !frequencies.empty();
+    }
+
+    // Highest frequency in the list; 1 when it has none.
+    uint32_t highest_frequency() const {
+        return max_frequency;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    Cursor cursor() const {
+        return Cursor(this);
+    }
+
+    // Prefetches the start of the skip table and of the postings.
+    void prefetch_head() const {
+        prefetch(skips.data());
+        prefetch(bytes.data());
+        if (weighted()) prefetch(frequencies.data());
+    }
+
+    std::vector<int> decode() const {
+        std::vector<int> ids;
+        ids.reserve(count);
+        for (Cursor it = cursor(); !it.done(); it.next()) {
+            ids.push_back(it.doc());
+        }
+        return ids;
+    }
+
+private:
+    std::vector<uint8_t> bytes;
+    std::vector<uint8_t> frequencies;
+    std::vector<Skip> skips;
+    int count = 0;
+    int last = -1;
+    uint32_t max_frequency = 1;
+
+    void append(int doc_id) {
+        if (count > 0 && doc_id <= last) {
+            throw std::invalid_argument("Posting IDs must be strictly increasing");
+        }
+        if (count % SKIP_INTERVAL == 0) {
+            skips.push_back({doc_id, bytes.size(), frequencies.size()});
+        } else {
+            write_varint(bytes, static_cast<uint32_t>(doc_id - last));
+        }
+        last = doc_id;
+        ++count;
+    }
+
+    static void write_varint(std::vector<uint8_t>& out, uint32_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    static uint32_t read_varint(const std::vector<uint8_t>& in, size_t& offset) {
+        uint32_t value = 0;
+        int shift = 0;
+        while (in[offset] & 0x80) {
+            value |= static_cast<uint32_t>(in[offset++] & 0x7F) << shift;
+            shift += 7;
+        }
+        value |= static_cast<uint32_t>(in[offset++]) << shift;
+        return value;
+    }
+};
+
+// Okapi BM25 with the usual k1 and b, and the idf that stays positive for
+// words in more than half of the books.
+namespace Bm25
+{
+    constexpr double K1 = 1.2;
+    constexpr double B = 0.75;
+
+    inline double idf(size_t books, size_t containing)
+    {
+        return std::log(1.0 + (books - containing + 0.5) / (containing + 0.5));
+    }
+
+    inline double score(double idf, uint32_t frequency, uint32_t length, double average_length)
+    {
+        double norm = K1 * (1.0 - B + B * length / average_length);
+        return idf * frequency * (K1 + 1.0) / (frequency + norm);
+    }
+
+    // No book reaches this for a word whose highest frequency is given: the
+    // score grows with frequency and is largest for a book of length 0.
+    inline double bound(double idf, uint32_t highest_frequency)
+    {
+        return idf * highest_frequency * (K1 + 1.0) / (highest_frequency + K1 * (1.0 - B));
+    }
+}
+
+// What ranking needs to know about the books of an index, all by book ID.
+struct BookStats {
+    const std::vector<uint32_t>& lengths;
+    const std::vector<bool>& live;
+    size_t live_books;
+    double average_length;
+};
+
+struct ScoredDoc {
+    int doc_id;
+    double score;
+};
+
+// Word -> PostingList. Book IDs must be added to each word in increasing order.
+// Words are interned in the index's vocabulary and their lists are stored by
+// word ID, so every distinct word is held once however many books use it.
+// For prefix queries the vocabulary is also kept in order: a front-coded
+// Dictionary plus the words added since it was built, which are merged into
+// it once they outnumber an eighth of it.
+class InvertedIndex {
+private:
+    static constexpr size_t MIN_RECENT = 4096;
+    // Lists lookup_batch() prefetches ahead of decoding.
+    static constexpr size_t BATCH = 16;
+
+    StringPool vocabulary;
+    std::vector<PostingList> postings;
+    Dictionary dictionary;
+    std::map<std::string_view, uint32_t> recent;
+
+    std::vector<const PostingList*> lists_for(const std::vector<std::string>& words) const {
+        std::vector<const PostingList*> lists;
+        lists.reserve(words.size());
+        for (const auto& word : words) {
+            lists.push_back(find(word));
+        }
+        return lists;
+    }
+
+    uint32_t id_for(std::string_view word) {
+        uint32_t id = vocabulary.intern(word);
+        if (id == postings.size()) {
+            postings.emplace_back();
+            recent.emplace(vocabulary.view(id), id);
+            if (recent.size() > std::max(MIN_RECENT, dictionary.size() / 8)) {
+                rebuild_dictionary();
+            }
+        }
+        return id;
+    }
+
+    void rebuild_dictionary() {
+        std::vector<std::string_view> words;
+        std::vector<uint32_t> ids;
+        words.reserve(dictionary.size() + recent.size());
+        ids.reserve(dictionary.size() + recent.size());
+        Dictionary::Cursor it = dictionary.cursor();
+        auto r = recent.begin();
+        while (!it.done() || r != recent.end()) {
+            if (r == recent.end() || (!it.done() && it.word() < r->first)) {
+                words.push_back(vocabulary.view(it.id()));
+                ids.push_back(it.id());
+                it.next();
+            } else {
+                words.push_back(r->first);
+                ids.push_back(r->second);
+                ++r;
+            }
+        }
+        dictionary = Dictionary(words, ids);
+        recent.clear();
+    }
+
+public:
+    // Returns the vocabulary's copy of word, which lives as long as the index.
+    std::string_view intern(std::string_view word) {
+        return vocabulary.view(id_for(word));
+    }
+
+    void add(std::string_view word, int doc_id) {
+        postings[id_for(word)].add(doc_id);
+    }
+
+    void add(std::string_view word, int doc_id, uint32_t frequency) {
+        postings[id_for(word)].add(doc_id, frequency);
+    }
+
+    const PostingList* find(std::string_view word) const {
+        std::optional<uint32_t> id = vocabulary.find(word);
+        return id ? &postings[*id] : nullptr;
+    }
+
+    // Rewrites every posting list through remap (old ID -> new ID, or -1 to
+    // drop it). remap must keep the relative order of the IDs it keeps.
+    // Words stay in the vocabulary even when their list becomes empty.
+    void compact(const std::vector<int>& remap) {
+        for (PostingList& list : postings) {
+            PostingList kept;
+            for (PostingList::Cursor c = list.cursor(); !c.done(); c.next()) {
+                if (remap[c.doc()] < 0) continue;
+                if (list.weighted()) {
+                    kept.add(remap[c.doc()], c.frequency());
+                } else {
+                    kept.add(remap[c.doc()]);
+                }
+            }
+            list = std::move(kept);
+        }
+    }
+
+    // Calls f(word, list) for the words starting with prefix, in order,
+    // until f returns false. Lists may be empty.
+    template <typename F>
+    void for_each_prefix(std::string_view prefix, F&& f) const {
+        auto matches = [&](std::string_view word) { return word.substr(0, prefix.size()) == prefix; };
+        Dictionary::Cursor it = dictionary.lower_bound(prefix);
+        auto r = recent.lower_bound(prefix);
+        while (true) {
+            bool in_dictionary = !it.done() && matches(it.word());
+            bool in_recent = r != recent.end() && matches(r->first);
+            if (in_dictionary && (!in_recent || it.word() < r->first)) {
+                if (!f(it.word(), postings[it.id()])) return;
+                it.next();
+            } else if (in_recent) {
+                if (!f(r->first, postings[r->second])) return;
+                ++r;
+            } else {
+                return;
+            }
+        }
+    }
+
+    std::vector<int> lookup(std::string_view word) const {
+        const PostingList* list = find(word);
+        return list ? list->decode() : std::vector<int>{};
+    }
+
+    // lookup() of every word. Lists are taken BATCH at a time: the list
+    // objects are prefetched, then the heads of their data, and only then
+    // is the first one decoded, so their cache misses overlap.
+    std::vector<std::vector<int>> lookup_batch(const std::vector<std::string>& words) const {
+        std::vector<const PostingList*> lists = lists_for(words);
+        std::vector<std::vector<int>> ans(lists.size());
+        for (size_t first = 0; first < lists.size(); first += BATCH) {
+            size_t last = std::min(lists.size(), first + BATCH);
+            for (size_t i = first; i < last; ++i) {
+                if (lists[i]) prefetch(lists[i]);
+            }
+            for (size_t i = first; i < last; ++i) {
+                if (lists[i]) lists[i]->prefetch_head();
+            }
+            for (size_t i = first; i < last; ++i) {
+                if (lists[i]) ans[i] = lists[i]->decode();
+            }
+        }
+        return ans;
+    }
+
+    // Leapfrog intersection driven by the shortest list; the others only
+    // advance_to() the current candidate, skipping blocks that cannot match.
+    std::vector<int> intersect(const std::vector<std::string>& words) const {
+        std::vector<const PostingList*> lists = lists_for(words);
+        if (lists.empty()) return {};
+        for (const PostingList* list : lists) {
+            if (list == nullptr) return {};
+        }
+        std::sort(lists.begin(), lists.end(), [](const PostingList* a, const PostingList* b) {
+            return a->size() < b->size();
+        });
+
+        std::vector<PostingList::Cursor> cursors;
+        cursors.reserve(lists.size());
+        for (const PostingList* list : lists) {
+            cursors.push_back(list->cursor());
+        }
+
+        std::vector<int> ans;
+        PostingList::Cursor& lead = cursors[0];
+        while (!lead.done()) {
+            int candidate = lead.doc();
+            bool matched = true;
+            for (size_t i = 1; i < cursors.size(); ++i) {
+                cursors[i].advance_to(candidate);
+                if (cursors[i].done()) return ans;
+                if (cursors[i].doc() != candidate) {
+                    lead.advance_to(cursors[i].doc());
+                    matched = false;
+                    break;
+                }
+            }
+            if (matched) {
+                ans.push_back(candidate);
+                lead.next();
+            }
+        }
+        return ans;
+    }
+
+    // k-way merge of the lists through a min-heap, dropping repeated IDs.
+    std::vector<int> unite(const std::vector<std::string>& words) const {
+        std::vector<PostingList::Cursor> cursors;
+        for (const PostingList* list : lists_for(words)) {
+            if (list != nullptr && !list->empty()) {
+                cursors.push_back(list->cursor());
+            }
+        }
+
+        using Head = std::pair<int, size_t>;
+        std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heap;
+        for (size_t i = 0; i < cursors.size(); ++i) {
+            heap.push({cursors[i].doc(), i});
+        }
+
+        std::vector<int> ans;
+        while (!heap.empty()) {
+            auto [doc_id, i] = heap.top();
+            heap.pop();
+            if (ans.empty() || ans.back() != doc_id) {
+                ans.push_back(doc_id);
+            }
+            cursors[i].next();
+            if (!cursors[i].done()) {
+                heap.push({cursors[i].doc(), i});
+            }
+        }
+        return ans;
+    }
+
+    // Top k live books for words by BM25, best first. Of books with equal
+    // scores, those before(a, b) puts first win, by default the lower book
+    // ID; a library whose IDs are not in title order passes a title
+    // comparison so that ties, and a tie at the k-th place, go by title.
+    // Lists without frequencies count every posting once; removed books
+    // still count towards a word's idf until the index is compacted.
+    //
+    // MaxScore: words are ordered by the most they can add to a score. The
+    // longest run of low words whose bounds sum below the k-th best score so
+    // far cannot make a book enter the top k alone, so only the remaining
+    // words' lists are walked for candidates. The low words are probed with
+    // advance_to(), most promising first, and only while the candidate can
+    // still get in.
+    template <typename Before = std::less<int>>
+    std::vector<ScoredDoc> rank(const std::vector<std::string>& words, size_t k, const BookStats& books,
+                                Before before = Before()) const {
+        if (k == 0) return {};
+        struct Term {
+            PostingList::Cursor cursor;
+            double idf;
+            double bound;
+        };
+        std::vector<std::string> unique(words);
+        std::sort(unique.begin(), unique.end());
+        unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+        std::vector<Term> terms;
+        for (const PostingList* list : lists_for(unique)) {
+            if (list == nullptr || list->empty()) continue;
+            double idf = Bm25::idf(std::max<size_t>(books.live_books, list->size()), list->size());
+            terms.push_back({list->cursor(), idf, Bm25::bound(idf, list->highest_frequency())});
+        }
+        std::sort(terms.begin(), terms.end(), [](const Term& a, const Term& b) { return a.bound < b.bound; });
+        // below[i]: the most terms [0, i] can add together.
+        std::vector<double> below(terms.size());
+        for (size_t i = 0; i < terms.size(); ++i) {
+            below[i] = terms[i].bound + (i > 0 ? below[i - 1] : 0.0);
+        }
+
+        double average_length = std::max(books.average_length, 1.0);
+        auto term_score = [&](const Term& term, int doc_id) {
+            return Bm25::score(term.idf, term.cursor.frequency(), books.lengths[doc_id], average_length);
+        };
+        // Heap top is the worst kept book.
+        auto better = [&](const ScoredDoc& a, const ScoredDoc& b) {
+            return a.score > b.score || (a.score == b.score && before(a.doc_id, b.doc_id));
+        };
+        std::priority_queue<ScoredDoc, std::vector<ScoredDoc>, decltype(better)> heap(better);
+        double threshold = -std::numeric_limits<double>::infinity();
+
+        size_t first_essential = 0;
+        while (true) {
+            while (first_essential < terms.size() && below[first_essential] < threshold) {
+                ++first_essential;
+            }
+            int candidate = std::numeric_limits<int>::max();
+            for (size_t i = first_essential; i < terms.size(); ++i) {
+                if (!terms[i].cursor.done()) {
+                    candidate = std::min(candidate, terms[i].cursor.doc());
+                }
+            }
+            if (candidate == std::numeric_limits<int>::max()) break;
+
+            bool live = books.live[candidate];
+            double score = 0.0;
+            for (size_t i = first_essential; i < terms.size(); ++i) {
+                PostingList::Cursor& cursor = terms[i].cursor;
+                if (!cursor.done() && cursor.doc() == candidate) {
+                    if (live) score += term_score(terms[i], candidate);
+                    cursor.next();
+                }
+            }
+            if (!live) continue;
+            for (size_t i = first_essential; i-- > 0;) {
+                if (score + below[i] < threshold) break;
+                PostingList::Cursor& cursor = terms[i].cursor;
+                cursor.advance_to(candidate);
+                if (!cursor.done() && cursor.doc() == candidate) {
+                    score += term_score(terms[i], candidate);
+                }
+            }
+
+            ScoredDoc scored{candidate, score};
+            if (heap.size() < k) {
+                heap.push(scored);
+            } else if (better(scored, heap.top())) {
+                heap.pop();
+                heap.push(scored);
+            }
+            if (heap.size() == k) {
+                threshold = heap.top().score;
+            }
+        }
+
+        std::vector<ScoredDoc> ans;
+        ans.reserve(heap.size());
+        while (!heap.empty()) {
+            ans.push_back(heap.top());
+            heap.pop();
+        }
+        std::reverse(ans.begin(), ans.end());
+        return ans;
+    }
+};
+
+#endif
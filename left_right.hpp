@@ -0,0 +1,88 @@
+#ifndef LEFT_RIGHT_HPP
+#define LEFT_RIGHT_HPP
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <cstddef>
+
+// Two copies of a T: readers use the published one without taking a lock,
+// the writer changes the other. A write applies its change to the standby
+// copy, publishes it, waits until every reader that could still be on the
+// old copy has left, then applies the same change to the old copy.
+//
+// Readers announce themselves in per-thread-group counters on their own
+// cache lines, so concurrent readers do not contend on a shared count.
+// Writes are serialized and cost the change twice; reads see either all
+// or none of a write.
+template <typename T>
+class LeftRight {
+public:
+    // Both copies come from make(), which must build equal values.
+    template <typename Make>
+    explicit LeftRight(Make make) : copies{make(), make()}, published(0) {}
+
+    LeftRight(const LeftRight&) = delete;
+    LeftRight& operator=(const LeftRight&) = delete;
+
+    // Returns f(copy). f must not modify the copy; any number of readers
+    // may run at once, and alongside a write.
+    template <typename F>
+    auto read(F&& f) const {
+        Slot& slot = slots[slot_index()];
+        int side;
+        while (true) {
+            side = published.load();
+            slot.readers[side].fetch_add(1);
+            // Re-checked after announcing: a writer that flipped in between
+            // might have missed the announcement.
+            if (published.load() == side) break;
+            slot.readers[side].fetch_sub(1);
+        }
+        struct Leave {
+            std::atomic<int>& readers;
+            ~Leave() { readers.fetch_sub(1); }
+        } leave{slot.readers[side]};
+        return f(static_cast<const T&>(copies[side]));
+    }
+
+    // Calls f on each copy in turn. f must be deterministic and must not
+    // throw, or the copies stop matching.
+    template <typename F>
+    void write(F&& f) {
+        std::lock_guard<std::mutex> guard(writer);
+        int side = published.load();
+        f(copies[1 - side]);
+        published.store(1 - side);
+        wait_for_readers(side);
+        f(copies[side]);
+    }
+
+private:
+    static constexpr size_t SLOTS = 64;
+
+    struct alignas(64) Slot {
+        std::atomic<int> readers[2] = {0, 0};
+    };
+
+    T copies[2];
+    std::atomic<int> published;
+    mutable Slot slots[SLOTS];
+    std::mutex writer;
+
+    static size_t slot_index() {
+        static std::atomic<size_t> next_thread{0};
+        thread_local size_t index = next_thread.fetch_add(1) % SLOTS;
+        return index;
+    }
+
+    void wait_for_readers(int side) const {
+        for (const Slot& slot : slots) {
+            while (slot.readers[side].load() != 0) {
+                std::this_thread::yield();
+            }
+        }
+    }
+};
+
+#endif
\ No newline at end of file
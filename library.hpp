@@ -2,149 +2,1489 @@
 #define LIBRARY_HPP
 
 #include "dynamic_hash_table.hpp"
+#include "inverted_index.hpp"
+#include "thread_pool.hpp"
+#include "string_sort.hpp"
+#include "tokenizer.hpp"
+#include "mapped_file.hpp"
+#include "snapshot.hpp"
+#include "left_right.hpp"
+#include "signature_index.hpp"
+#include "worker_process.hpp"
+#include "result_cache.hpp"
 #include <vector>
 #include <string>
 #include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <string_view>
+#include <filesystem>
+#include <memory>
+#include <functional>
+#include <queue>
 
-std::vector<int> get_primes(int start = 1000, int end = 100000) {
-    std::vector<bool> is_prime(end + 1, true);
-    is_prime[0] = is_prime[1] = false;
-    for (int i = 2; i * i <= end; ++i) {
-        if (is_prime[i]) {
-            for (int j = i * i; j <= end; j += i) {
-                is_prime[j] = false;
-            }
-        }
+// Words in all texts, repeats included.
+inline size_t total_words(const std::vector<std::vector<std::string>>& texts) {
+    size_t words = 0;
+    for (const auto& text : texts) {
+        words += text.size();
     }
-    std::vector<int> prime_sizes;
-    for (int i = end; i >= start; --i) {
-        if (is_prime[i]) prime_sizes.push_back(i);
-    }
-    return prime_sizes;
+    return words;
+}
+
+// Streams the tokens of a file through f. Only the window being scanned is
+// mapped; tokens are views valid during the call.
+template <typename F>
+void for_each_file_token(const std::string& path, F&& f) {
+    MappedFile file(path);
+    Tokenizer::Stream<F&> stream(f);
+    file.for_each_window([&](std::string_view window) { stream.feed(window); });
+    stream.finish();
 }
 
+// A word and the titles of the books containing it.
+struct PrefixMatch {
+    std::string word;
+    std::vector<std::string> books;
+};
+
+// A book and its BM25 score for a query.
+struct RankedBook {
+    std::string title;
+    double score;
+};
+
 class DigitalLibrary {
 public:
-    virtual std::vector<std::string> distinct_words(const std::string& book_title) = 0;
+    // The book's distinct words, sorted, and the titles of the books
+    // containing keyword, sorted, as views into the library. They stay
+    // valid until the library is next modified.
+    virtual std::vector<std::string_view> distinct_word_views(const std::string& book_title) = 0;
+    virtual std::vector<std::string_view> search_keyword_views(const std::string& keyword) = 0;
+
+    // Copying forms of the views above.
+    virtual std::vector<std::string> distinct_words(const std::string& book_title) {
+        std::vector<std::string_view> words = distinct_word_views(book_title);
+        return std::vector<std::string>(words.begin(), words.end());
+    }
+
+    virtual std::vector<std::string> search_keyword(const std::string& keyword) {
+        std::vector<std::string_view> titles = search_keyword_views(keyword);
+        return std::vector<std::string>(titles.begin(), titles.end());
+    }
+
     virtual int count_distinct_words(const std::string& book_title) = 0;
-    virtual std::vector<std::string> search_keyword(const std::string& keyword) = 0;
+
+    // search_keyword() of each keyword, in order. Libraries with an index
+    // override this to resolve the whole batch together.
+    virtual std::vector<std::vector<std::string>> search_keywords(const std::vector<std::string>& keywords) {
+        std::vector<std::vector<std::string>> ans;
+        ans.reserve(keywords.size());
+        for (const auto& keyword : keywords) {
+            ans.push_back(search_keyword(keyword));
+        }
+        return ans;
+    }
+
+    virtual std::vector<std::string> search_all(const std::vector<std::string>& keywords) = 0;
+    virtual std::vector<std::string> search_any(const std::vector<std::string>& keywords) = 0;
+    // The first `limit` words in alphabetical order that start with prefix
+    // and are in some book, each with the books containing it.
+    virtual std::vector<PrefixMatch> search_prefix(const std::string& prefix, size_t limit) = 0;
+    // The k books that best match keywords by BM25, best first and equal
+    // scores in title order.
+    virtual std::vector<RankedBook> search_ranked(const std::vector<std::string>& keywords, size_t k) = 0;
     virtual void print_books() = 0;
+    // Titles of the books currently in the library, sorted.
+    virtual std::vector<std::string> book_titles() = 0;
     virtual void add_book(const std::string& book_title, const std::vector<std::string>& text) = 0;
+
+    // Adds the books in order, with the same result as add_book on each.
+    virtual void add_books(const std::vector<std::string>& book_titles, const std::vector<std::vector<std::string>>& texts) {
+        if (book_titles.size() != texts.size()) {
+            throw std::invalid_argument("Every book needs a title and a text");
+        }
+        for (size_t i = 0; i < book_titles.size(); ++i) {
+            add_book(book_titles[i], texts[i]);
+        }
+    }
+
+    // Adds the book stored in a text file, split on whitespace. Libraries
+    // that can take tokens as views override this to skip the vector.
+    virtual void add_book_from_file(const std::string& book_title, const std::string& path) {
+        std::vector<std::string> text;
+        for_each_file_token(path, [&](std::string_view token) { text.emplace_back(token); });
+        add_book(book_title, text);
+    }
+
+    // Adds every regular file in directory in file name order, titled by
+    // its name without the extension.
+    void add_books_from_directory(const std::string& directory) {
+        std::vector<std::filesystem::path> files;
+        for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+            if (entry.is_regular_file()) {
+                files.push_back(entry.path());
+            }
+        }
+        std::sort(files.begin(), files.end());
+        for (const auto& file : files) {
+            add_book_from_file(file.stem().string(), file.string());
+        }
+    }
+
+    virtual void remove_book(const std::string& book_title) = 0;
+
+    // Writes every book and its distinct words to a snapshot that
+    // load_snapshot() can serve without rebuilding anything.
+    virtual void save_snapshot(const std::string& path) {
+        std::vector<std::string> titles = book_titles();
+        titles.erase(std::unique(titles.begin(), titles.end()), titles.end());
+        std::vector<std::vector<std::string>> words;
+        words.reserve(titles.size());
+        for (const auto& title : titles) {
+            words.push_back(distinct_words(title));
+        }
+        Snapshot::write(path, titles, words);
+    }
+
     virtual ~DigitalLibrary() = default;
 };
 
+// How MuskLibrary answers search_keyword, search_keywords, search_all and
+// search_any. Postings reads the inverted index. Signatures ANDs the
+// SignatureIndex slices of the keywords and binary searches the word list
+// of each candidate book only.
+enum class SearchMode {
+    Postings,
+    Signatures
+};
+
+struct SignatureOptions {
+    double false_positive_rate = 0.01;
+    // Bytes the slices may take; 0 for no limit.
+    size_t memory_budget = 0;
+};
+
 class MuskLibrary : public DigitalLibrary {
 private:
     std::vector<std::pair<std::string, std::vector<std::string>>> lib;
+    InvertedIndex index;
+    std::vector<bool> live;
+    std::vector<uint32_t> lengths;
+    int retired = 0;
+    uint64_t total_length = 0;
+    SearchMode search_mode = SearchMode::Postings;
+    SignatureOptions signature_options;
+    SignatureIndex signatures;
 
-    static bool comp1(const std::string& a, const std::string& b) {
-        return a < b;
+    std::vector<std::string> to_titles(const std::vector<int>& doc_ids) const {
+        std::vector<std::string> ans;
+        ans.reserve(doc_ids.size());
+        for (int doc_id : doc_ids) {
+            if (live[doc_id]) {
+                ans.push_back(lib[doc_id].first);
+            }
+        }
+        return ans;
     }
 
-    static bool comp2(const std::pair<std::string, std::vector<std::string>>& a,
-                      const std::pair<std::string, std::vector<std::string>>& b) {
-        return a.first < b.first;
+    int position(const std::string& book_title) const {
+        int i = 0, j = lib.size() - 1;
+        while (i <= j) {
+            int mid = i + (j - i) / 2;
+            if (lib[mid].first == book_title) {
+                return mid;
+            } else if (lib[mid].first < book_title) {
+                i = mid + 1;
+            } else {
+                j = mid - 1;
+            }
+        }
+        return -1;
     }
 
-    std::vector<std::string> merge_sort(std::vector<std::string> arr, bool (*compare)(const std::string&, const std::string&)) const {
-        if (arr.size() <= 1) return arr;
-        size_t mid = arr.size() / 2;
-        std::vector<std::string> l1(arr.begin(), arr.begin() + mid);
-        std::vector<std::string> l2(arr.begin() + mid, arr.end());
-        l1 = merge_sort(l1, compare);
-        l2 = merge_sort(l2, compare);
-        return merge(l1, l2, compare);
+    // Removed books keep their position until they outnumber the live ones;
+    // then the catalog and the posting lists are rewritten without them.
+    void compact() {
+        std::vector<int> remap(lib.size(), -1);
+        std::vector<std::pair<std::string, std::vector<std::string>>> kept;
+        std::vector<uint32_t> kept_lengths;
+        for (size_t i = 0; i < lib.size(); ++i) {
+            if (live[i]) {
+                remap[i] = static_cast<int>(kept.size());
+                kept.push_back(std::move(lib[i]));
+                kept_lengths.push_back(lengths[i]);
+            }
+        }
+        lib = std::move(kept);
+        lengths = std::move(kept_lengths);
+        live.assign(lib.size(), true);
+        retired = 0;
+        index.compact(remap);
+        if (search_mode == SearchMode::Signatures) {
+            build_signatures();
+        }
     }
 
-    std::vector<std::pair<std::string, std::vector<std::string>>> merge_sort(
-        std::vector<std::pair<std::string, std::vector<std::string>>> arr,
-        bool (*compare)(const std::pair<std::string, std::vector<std::string>>&, const std::pair<std::string, std::vector<std::string>>&)) const {
-        if (arr.size() <= 1) return arr;
-        size_t mid = arr.size() / 2;
-        std::vector<std::pair<std::string, std::vector<std::string>>> l1(arr.begin(), arr.begin() + mid);
-        std::vector<std::pair<std::string, std::vector<std::string>>> l2(arr.begin() + mid, arr.end());
-        l1 = merge_sort(l1, compare);
-        l2 = merge_sort(l2, compare);
-        return merge(l1, l2, compare);
+    void build_signatures() {
+        size_t max_words = 0;
+        for (const auto& book : lib) {
+            max_words = std::max(max_words, book.second.size());
+        }
+        signatures = SignatureIndex(lib.size(), max_words, signature_options.false_positive_rate, signature_options.memory_budget);
+        for (size_t i = 0; i < lib.size(); ++i) {
+            for (const auto& word : lib[i].second) {
+                signatures.add(i, word);
+            }
+        }
     }
 
-    template<typename T>
-    std::vector<T> merge(const std::vector<T>& l1, const std::vector<T>& l2, bool (*compare)(const T&, const T&)) const {
-        std::vector<T> result;
-        size_t i = 0, j = 0;
-        while (i < l1.size() && j < l2.size()) {
-            if (compare(l1[i], l2[j])) {
-                result.push_back(l1[i++]);
-            } else {
-                result.push_back(l2[j++]);
+    bool holds(int doc_id, const std::string& word) const {
+        const auto& words = lib[doc_id].second;
+        return std::binary_search(words.begin(), words.end(), word);
+    }
+
+    // Calls f(doc_id) for the live books whose signatures hold every word,
+    // in catalog order.
+    template <typename F>
+    void for_each_candidate(const std::vector<std::string>& words, F&& f) const {
+        std::vector<uint64_t> bits;
+        signatures.candidates(words, bits);
+        for_each_set_bit(bits, f);
+    }
+
+    template <typename F>
+    void for_each_set_bit(const std::vector<uint64_t>& bits, F&& f) const {
+        SignatureIndex::for_each_book(bits, [&](size_t book) {
+            if (live[book]) f(static_cast<int>(book));
+        });
+    }
+
+public:
+    // Texts are sorted and deduplicated on up to `threads` threads (0: one
+    // per hardware thread), or inline when they are too small to be worth
+    // it; the catalog and index are then built serially. With
+    // term_frequencies the postings also count how often each book uses the
+    // word, which search_ranked() weighs.
+    MuskLibrary(const std::vector<std::string>& book_titles, const std::vector<std::vector<std::string>>& texts, int threads = 0,
+                bool term_frequencies = false) {
+        struct Book {
+            std::pair<std::string, std::vector<std::string>> entry;
+            std::vector<uint32_t> frequencies;
+            uint32_t length;
+        };
+        std::vector<Book> sorted(book_titles.size());
+        ThreadPool pool(ThreadPool::threads_for(texts.size(), total_words(texts), threads));
+        pool.parallel_for(sorted.size(), [&](size_t i) {
+            Book& book = sorted[i];
+            book.entry.first = book_titles[i];
+            book.length = static_cast<uint32_t>(texts[i].size());
+            std::vector<std::string>& words = book.entry.second;
+            words = texts[i];
+            if (!term_frequencies) {
+                StringSort::sort_unique(words);
+                return;
+            }
+            // Equal words are adjacent once sorted: keep one of each run.
+            StringSort::sort(words);
+            size_t kept = 0;
+            for (size_t w = 0; w < words.size(); ++w) {
+                if (kept > 0 && words[w] == words[kept - 1]) {
+                    book.frequencies.back()++;
+                } else {
+                    if (kept != w) words[kept] = std::move(words[w]);
+                    kept++;
+                    book.frequencies.push_back(1);
+                }
+            }
+            words.resize(kept);
+        });
+        StringSort::sort(sorted, [](const Book& book) -> const std::string& { return book.entry.first; });
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            lib.push_back(std::move(sorted[i].entry));
+            lengths.push_back(sorted[i].length);
+            total_length += sorted[i].length;
+            for (size_t w = 0; w < lib[i].second.size(); ++w) {
+                if (term_frequencies) {
+                    index.add(lib[i].second[w], static_cast<int>(i), sorted[i].frequencies[w]);
+                } else {
+                    index.add(lib[i].second[w], static_cast<int>(i));
+                }
             }
         }
-        result.insert(result.end(), l1.begin() + i, l1.end());
-        result.insert(result.end(), l2.begin() + j, l2.end());
-        return result;
+        live.assign(lib.size(), true);
+    }
+
+    void add_book(const std::string&, const std::vector<std::string>&) override {}
+
+    // Switching to Signatures builds the slices over the current catalog.
+    void set_search_mode(SearchMode mode, const SignatureOptions& options = {}) {
+        search_mode = mode;
+        signature_options = options;
+        if (mode == SearchMode::Signatures) {
+            build_signatures();
+        } else {
+            signatures = SignatureIndex();
+        }
+    }
+
+    const SignatureIndex& signature_index() const {
+        return signatures;
+    }
+
+    void remove_book(const std::string& book_title) override {
+        int pos = position(book_title);
+        if (pos < 0 || !live[pos]) return;
+        live[pos] = false;
+        std::vector<std::string>().swap(lib[pos].second);
+        retired++;
+        total_length -= lengths[pos];
+        if (retired > static_cast<int>(lib.size()) - retired) {
+            compact();
+        }
+    }
+
+    std::vector<std::string_view> distinct_word_views(const std::string& book_title) override {
+        int pos = position(book_title);
+        if (pos < 0 || !live[pos]) return {};
+        return std::vector<std::string_view>(lib[pos].second.begin(), lib[pos].second.end());
+    }
+
+    std::vector<std::string> distinct_words(const std::string& book_title) override {
+        int pos = position(book_title);
+        if (pos < 0 || !live[pos]) return {};
+        return lib[pos].second;
+    }
+
+    int count_distinct_words(const std::string& book_title) override {
+        int pos = position(book_title);
+        return pos < 0 || !live[pos] ? 0 : static_cast<int>(lib[pos].second.size());
+    }
+
+    std::vector<std::string_view> search_keyword_views(const std::string& keyword) override {
+        std::vector<std::string_view> ans;
+        if (search_mode == SearchMode::Signatures) {
+            for_each_candidate({keyword}, [&](int doc_id) {
+                if (holds(doc_id, keyword)) ans.push_back(lib[doc_id].first);
+            });
+            return ans;
+        }
+        for (int doc_id : index.lookup(keyword)) {
+            if (live[doc_id]) ans.push_back(lib[doc_id].first);
+        }
+        return ans;
+    }
+
+    std::vector<std::vector<std::string>> search_keywords(const std::vector<std::string>& keywords) override {
+        if (search_mode == SearchMode::Signatures) {
+            return DigitalLibrary::search_keywords(keywords);
+        }
+        std::vector<std::vector<std::string>> ans;
+        ans.reserve(keywords.size());
+        for (const auto& doc_ids : index.lookup_batch(keywords)) {
+            ans.push_back(to_titles(doc_ids));
+        }
+        return ans;
+    }
+
+    std::vector<std::string> search_all(const std::vector<std::string>& keywords) override {
+        if (search_mode == SearchMode::Postings) {
+            return to_titles(index.intersect(keywords));
+        }
+        std::vector<std::string> ans;
+        if (keywords.empty()) return ans;
+        for_each_candidate(keywords, [&](int doc_id) {
+            for (const auto& keyword : keywords) {
+                if (!holds(doc_id, keyword)) return;
+            }
+            ans.push_back(lib[doc_id].first);
+        });
+        return ans;
+    }
+
+    // Signatures mode ORs the candidates of each keyword before the exact
+    // checks, so every book is checked at most once.
+    std::vector<std::string> search_any(const std::vector<std::string>& keywords) override {
+        if (search_mode == SearchMode::Postings) {
+            return to_titles(index.unite(keywords));
+        }
+        std::vector<uint64_t> any(signatures.words_per_slice(), 0);
+        std::vector<uint64_t> bits;
+        for (const auto& keyword : keywords) {
+            signatures.candidates({keyword}, bits);
+            for (size_t w = 0; w < any.size(); ++w) {
+                any[w] |= bits[w];
+            }
+        }
+        std::vector<std::string> ans;
+        for_each_set_bit(any, [&](int doc_id) {
+            for (const auto& keyword : keywords) {
+                if (holds(doc_id, keyword)) {
+                    ans.push_back(lib[doc_id].first);
+                    return;
+                }
+            }
+        });
+        return ans;
+    }
+
+    std::vector<PrefixMatch> search_prefix(const std::string& prefix, size_t limit) override {
+        std::vector<PrefixMatch> ans;
+        if (limit == 0) return ans;
+        index.for_each_prefix(prefix, [&](std::string_view word, const PostingList& list) {
+            std::vector<std::string> books = to_titles(list.decode());
+            if (!books.empty()) {
+                ans.push_back({std::string(word), std::move(books)});
+            }
+            return ans.size() < limit;
+        });
+        return ans;
+    }
+
+    // Books are numbered in title order, so rank() breaks ties by title.
+    std::vector<RankedBook> search_ranked(const std::vector<std::string>& keywords, size_t k) override {
+        size_t books = lib.size() - retired;
+        double average_length = books == 0 ? 0.0 : static_cast<double>(total_length) / books;
+        std::vector<RankedBook> ans;
+        for (const ScoredDoc& doc : index.rank(keywords, k, {lengths, live, books, average_length})) {
+            ans.push_back({lib[doc.doc_id].first, doc.score});
+        }
+        return ans;
+    }
+
+    std::vector<std::string> book_titles() override {
+        std::vector<std::string> ans;
+        for (size_t i = 0; i < lib.size(); ++i) {
+            if (live[i]) {
+                ans.push_back(lib[i].first);
+            }
+        }
+        return ans;
+    }
+
+    void print_books() override {
+        for (size_t i = 0; i < lib.size(); ++i) {
+            if (!live[i]) continue;
+            const auto& [book, text] = lib[i];
+            std::ostringstream oss;
+            for (size_t i = 0; i < text.size(); ++i) {
+                oss << text[i];
+                if (i < text.size() - 1) oss << " | ";
+            }
+            std::cout << book << ": " << oss.str() << std::endl;
+        }
+    }
+};
+
+class JGBLibrary : public DigitalLibrary {
+private:
+    std::string collision_type;
+    std::vector<int> params;
+    HashFunction hash_function;
+    int threads;
+    bool term_frequencies;
+    InvertedIndex index;
+    DynamicHashMap<DynamicWordSet> books;
+    std::vector<std::string> titles;
+    std::vector<bool> live;
+    std::vector<uint32_t> lengths;
+    std::unordered_map<std::string, int> doc_ids;
+    int retired = 0;
+    uint64_t total_length = 0;
+
+    // Occurrences of each word of one book, keyed by the index's copy.
+    using Counts = std::unordered_map<std::string_view, uint32_t, FastHash::Hasher>;
+
+    static std::string collision_type_for(const std::string& name) {
+        if (name == "Jobs") {
+            return "Chain";
+        } else if (name == "Gates") {
+            return "Linear";
+        } else if (name == "Bezos") {
+            return "Double";
+        }
+        throw std::invalid_argument("Invalid library name");
     }
 
-    std::vector<std::string> remove_duplicates(std::vector<std::string> arr) const {
-        if (arr.empty()) return arr;
+    // Book IDs follow insertion order, so matches are re-sorted by title.
+    std::vector<std::string> to_titles(const std::vector<int>& ids) const {
         std::vector<std::string> ans;
-        ans.push_back(arr[0]);
-        for (size_t i = 1; i < arr.size(); ++i) {
-            if (ans.back() != arr[i]) {
-                ans.push_back(arr[i]);
+        ans.reserve(ids.size());
+        for (int doc_id : ids) {
+            if (live[doc_id]) {
+                ans.push_back(titles[doc_id]);
             }
         }
+        StringSort::sort(ans);
         return ans;
     }
 
+    void retire(int doc_id) {
+        live[doc_id] = false;
+        retired++;
+        total_length -= lengths[doc_id];
+    }
+
+    // Retired IDs are dropped once they outnumber live books: live books are
+    // renumbered densely in their old order and the postings rewritten.
+    void compact_if_needed() {
+        if (retired <= static_cast<int>(doc_ids.size())) return;
+        std::vector<int> remap(titles.size(), -1);
+        std::vector<std::string> kept;
+        std::vector<uint32_t> kept_lengths;
+        for (size_t doc_id = 0; doc_id < titles.size(); ++doc_id) {
+            if (live[doc_id]) {
+                remap[doc_id] = static_cast<int>(kept.size());
+                kept.push_back(std::move(titles[doc_id]));
+                kept_lengths.push_back(lengths[doc_id]);
+            }
+        }
+        for (auto& [book, doc_id] : doc_ids) {
+            doc_id = remap[doc_id];
+        }
+        titles = std::move(kept);
+        lengths = std::move(kept_lengths);
+        live.assign(titles.size(), true);
+        retired = 0;
+        index.compact(remap);
+    }
+
+    // The book's set only holds views of the index vocabulary. Each set grows
+    // through its own prime sequence, so building one touches no shared state.
+    DynamicWordSet make_word_set() const {
+        return DynamicWordSet(collision_type, params, RehashMode::Full, hash_function, Growth::Prime);
+    }
+
+    // Adds one word occurrence to the book being built.
+    void add_token(std::string_view token, DynamicWordSet& words, Counts& counts) {
+        std::string_view word = index.intern(token);
+        words.insert(word);
+        if (term_frequencies) {
+            counts[word]++;
+        }
+    }
+
+    // counts is only read with term frequencies on; length is the book's
+    // number of words, repeats included.
+    void add_word_set(const std::string& book_title, DynamicWordSet&& words, const Counts& counts, uint32_t length) {
+        // Re-adding a title retires its old ID so stale postings stop matching.
+        int doc_id = static_cast<int>(titles.size());
+        auto it = doc_ids.find(book_title);
+        if (it != doc_ids.end()) {
+            retire(it->second);
+            it->second = doc_id;
+        } else {
+            doc_ids.emplace(book_title, doc_id);
+        }
+        titles.push_back(book_title);
+        live.push_back(true);
+        lengths.push_back(length);
+        total_length += length;
+        for (std::string_view word : words.views()) {
+            if (term_frequencies) {
+                index.add(word, doc_id, counts.at(word));
+            } else {
+                index.add(word, doc_id);
+            }
+        }
+        books.insert({book_title, std::move(words)});
+        compact_if_needed();
+    }
+
 public:
-    MuskLibrary(const std::vector<std::string>& book_titles, const std::vector<std::vector<std::string>>& texts) {
-        std::vector<std::vector<std::string>> sorted_texts = texts;
-        for (auto& text : sorted_texts) {
-            text = merge_sort(text, comp1);
-            text = remove_duplicates(text);
+    // add_books() spreads its per-book work over up to `threads` threads
+    // (0: one per hardware thread) when the batch is large enough. With
+    // term_frequencies_ the postings also count how often each book uses the
+    // word, which search_ranked() weighs.
+    JGBLibrary(const std::string& name, const std::vector<int>& params_, HashFunction hash_function_ = HashFunction::Polynomial,
+               int threads_ = 0, bool term_frequencies_ = false)
+        : collision_type(collision_type_for(name)), params(params_), hash_function(hash_function_), threads(threads_),
+          term_frequencies(term_frequencies_),
+          books(collision_type, params, RehashMode::Incremental, hash_function, Growth::Prime) {}
+
+    void add_book(const std::string& book_title, const std::vector<std::string>& text) override {
+        DynamicWordSet words = make_word_set();
+        Counts counts;
+        for (const auto& token : text) {
+            add_token(token, words, counts);
+        }
+        add_word_set(book_title, std::move(words), counts, static_cast<uint32_t>(text.size()));
+    }
+
+    // Tokens go straight from the mapped file into the book's set; only
+    // words new to the library are copied, into the index vocabulary.
+    void add_book_from_file(const std::string& book_title, const std::string& path) override {
+        DynamicWordSet words = make_word_set();
+        Counts counts;
+        uint32_t length = 0;
+        for_each_file_token(path, [&](std::string_view token) {
+            add_token(token, words, counts);
+            length++;
+        });
+        add_word_set(book_title, std::move(words), counts, length);
+    }
+
+    // Each text is reduced to its distinct words in first-seen order, with
+    // their counts, in parallel. The words are interned serially, the
+    // books' sets built in parallel again, and the postings added in batch
+    // order.
+    void add_books(const std::vector<std::string>& book_titles, const std::vector<std::vector<std::string>>& texts) override {
+        if (book_titles.size() != texts.size()) {
+            throw std::invalid_argument("Every book needs a title and a text");
+        }
+        std::vector<std::vector<std::string_view>> distinct(texts.size());
+        std::vector<std::vector<uint32_t>> frequencies(texts.size());
+        ThreadPool pool(ThreadPool::threads_for(texts.size(), total_words(texts), threads));
+        pool.parallel_for(texts.size(), [&](size_t i) {
+            std::unordered_map<std::string_view, uint32_t, FastHash::Hasher> seen;
+            seen.reserve(texts[i].size());
+            for (const auto& word : texts[i]) {
+                auto [it, added] = seen.try_emplace(word, static_cast<uint32_t>(distinct[i].size()));
+                if (added) {
+                    distinct[i].push_back(word);
+                    frequencies[i].push_back(0);
+                }
+                frequencies[i][it->second]++;
+            }
+        });
+        for (auto& words : distinct) {
+            for (auto& word : words) {
+                word = index.intern(word);
+            }
+        }
+        std::vector<DynamicWordSet> sets;
+        sets.reserve(texts.size());
+        for (size_t i = 0; i < texts.size(); ++i) {
+            sets.push_back(make_word_set());
         }
+        std::vector<Counts> counts(texts.size());
+        pool.parallel_for(texts.size(), [&](size_t i) {
+            for (size_t w = 0; w < distinct[i].size(); ++w) {
+                sets[i].insert(distinct[i][w]);
+                if (term_frequencies) {
+                    counts[i][distinct[i][w]] = frequencies[i][w];
+                }
+            }
+        });
         for (size_t i = 0; i < book_titles.size(); ++i) {
-            lib.emplace_back(book_titles[i], sorted_texts[i]);
+            add_word_set(book_titles[i], std::move(sets[i]), counts[i], static_cast<uint32_t>(texts[i].size()));
+        }
+    }
+
+    void remove_book(const std::string& book_title) override {
+        auto it = doc_ids.find(book_title);
+        if (it == doc_ids.end()) return;
+        retire(it->second);
+        doc_ids.erase(it);
+        books.erase(book_title);
+        compact_if_needed();
+    }
+
+    // The words are views of the index vocabulary, which never shrinks, so
+    // unlike the title views they outlive later adds and removals.
+    std::vector<std::string_view> distinct_word_views(const std::string& book_title) override {
+        const DynamicWordSet* words = books.find_ptr(book_title);
+        if (words == nullptr) return {};
+        std::vector<std::string_view> ans = words->views();
+        StringSort::sort(ans);
+        return ans;
+    }
+
+    int count_distinct_words(const std::string& book_title) override {
+        const DynamicWordSet* words = books.find_ptr(book_title);
+        return words ? words->get_size() : 0;
+    }
+
+    std::vector<std::string_view> search_keyword_views(const std::string& keyword) override {
+        std::vector<std::string_view> ans;
+        for (int doc_id : index.lookup(keyword)) {
+            if (live[doc_id]) ans.push_back(titles[doc_id]);
+        }
+        StringSort::sort(ans);
+        return ans;
+    }
+
+    std::vector<std::vector<std::string>> search_keywords(const std::vector<std::string>& keywords) override {
+        std::vector<std::vector<std::string>> ans;
+        ans.reserve(keywords.size());
+        for (const auto& doc_ids : index.lookup_batch(keywords)) {
+            ans.push_back(to_titles(doc_ids));
+        }
+        return ans;
+    }
+
+    std::vector<std::string> search_all(const std::vector<std::string>& keywords) override {
+        return to_titles(index.intersect(keywords));
+    }
+
+    std::vector<std::string> search_any(const std::vector<std::string>& keywords) override {
+        return to_titles(index.unite(keywords));
+    }
+
+    std::vector<PrefixMatch> search_prefix(const std::string& prefix, size_t limit) override {
+        std::vector<PrefixMatch> ans;
+        if (limit == 0) return ans;
+        index.for_each_prefix(prefix, [&](std::string_view word, const PostingList& list) {
+            std::vector<std::string> books = to_titles(list.decode());
+            if (!books.empty()) {
+                ans.push_back({std::string(word), std::move(books)});
+            }
+            return ans.size() < limit;
+        });
+        return ans;
+    }
+
+    std::vector<RankedBook> search_ranked(const std::vector<std::string>& keywords, size_t k) override {
+        double average_length = doc_ids.empty() ? 0.0 : static_cast<double>(total_length) / doc_ids.size();
+        std::vector<RankedBook> ans;
+        auto by_title = [&](int a, int b) { return titles[a] < titles[b]; };
+        for (const ScoredDoc& doc : index.rank(keywords, k, {lengths, live, doc_ids.size(), average_length}, by_title)) {
+            ans.push_back({titles[doc.doc_id], doc.score});
+        }
+        return ans;
+    }
+
+    std::vector<std::string> book_titles() override {
+        std::vector<std::string> ans;
+        ans.reserve(doc_ids.size());
+        for (const auto& [book, doc_id] : doc_ids) {
+            ans.push_back(book);
+        }
+        StringSort::sort(ans);
+        return ans;
+    }
+
+    void print_books() override {
+        for (const auto& book : book_titles()) {
+            std::cout << book << ": " << books.find_ptr(book)->to_string() << std::endl;
+        }
+    }
+};
+
+// Read-only library answered straight from a snapshot file. Opening one only
+// maps the file and checks its header, so startup time does not grow with
+// the library, and processes serving the same file share its pages. Like
+// MuskLibrary's add_book, add_book and remove_book do nothing.
+class SnapshotLibrary : public DigitalLibrary {
+private:
+    Snapshot::Reader snapshot;
+
+    std::vector<std::string> to_titles(const std::vector<uint32_t>& books) const {
+        std::vector<std::string> ans;
+        ans.reserve(books.size());
+        for (uint32_t book : books) {
+            ans.emplace_back(snapshot.title(book));
+        }
+        return ans;
+    }
+
+    std::vector<std::string> to_titles(const Snapshot::IdRange& books) const {
+        return to_titles(std::vector<uint32_t>(books.begin(), books.end()));
+    }
+
+public:
+    explicit SnapshotLibrary(const std::string& path, Snapshot::Check check = Snapshot::Check::Header)
+        : snapshot(path, check) {}
+
+    std::vector<std::string_view> distinct_word_views(const std::string& book_title) override {
+        std::optional<uint32_t> book = snapshot.find_title(book_title);
+        if (!book) return {};
+        std::vector<std::string_view> ans;
+        ans.reserve(snapshot.book_words(*book).size());
+        for (uint32_t id : snapshot.book_words(*book)) {
+            ans.push_back(snapshot.word(id));
+        }
+        return ans;
+    }
+
+    int count_distinct_words(const std::string& book_title) override {
+        std::optional<uint32_t> book = snapshot.find_title(book_title);
+        return book ? static_cast<int>(snapshot.book_words(*book).size()) : 0;
+    }
+
+    std::vector<std::string_view> search_keyword_views(const std::string& keyword) override {
+        std::optional<uint32_t> id = snapshot.find_word(keyword);
+        if (!id) return {};
+        std::vector<std::string_view> ans;
+        ans.reserve(snapshot.postings(*id).size());
+        for (uint32_t book : snapshot.postings(*id)) {
+            ans.push_back(snapshot.title(book));
+        }
+        return ans;
+    }
+
+    // Walks the shortest posting list; the others are only searched forward
+    // from their last match.
+    std::vector<std::string> search_all(const std::vector<std::string>& keywords) override {
+        std::vector<Snapshot::IdRange> lists;
+        for (const auto& keyword : keywords) {
+            std::optional<uint32_t> id = snapshot.find_word(keyword);
+            if (!id) return {};
+            lists.push_back(snapshot.postings(*id));
+        }
+        if (lists.empty()) return {};
+        std::sort(lists.begin(), lists.end(), [](const auto& a, const auto& b) { return a.size() < b.size(); });
+        std::vector<const uint32_t*> cursors;
+        for (const auto& list : lists) {
+            cursors.push_back(list.begin());
+        }
+        std::vector<uint32_t> matches;
+        for (uint32_t book : lists[0]) {
+            bool matched = true;
+            for (size_t i = 1; i < lists.size() && matched; ++i) {
+                cursors[i] = std::lower_bound(cursors[i], lists[i].end(), book);
+                if (cursors[i] == lists[i].end()) return to_titles(matches);
+                matched = *cursors[i] == book;
+            }
+            if (matched) matches.push_back(book);
+        }
+        return to_titles(matches);
+    }
+
+    std::vector<std::string> search_any(const std::vector<std::string>& keywords) override {
+        std::vector<uint32_t> matches;
+        for (const auto& keyword : keywords) {
+            std::optional<uint32_t> id = snapshot.find_word(keyword);
+            if (id) {
+                Snapshot::IdRange list = snapshot.postings(*id);
+                matches.insert(matches.end(), list.begin(), list.end());
+            }
+        }
+        std::sort(matches.begin(), matches.end());
+        matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+        return to_titles(matches);
+    }
+
+    std::vector<PrefixMatch> search_prefix(const std::string& prefix, size_t limit) override {
+        std::vector<PrefixMatch> ans;
+        for (uint32_t id = snapshot.lower_bound_word(prefix); id < snapshot.word_count() && ans.size() < limit; ++id) {
+            std::string_view word = snapshot.word(id);
+            if (word.substr(0, prefix.size()) != prefix) break;
+            ans.push_back({std::string(word), to_titles(snapshot.postings(id))});
+        }
+        return ans;
+    }
+
+    // The snapshot keeps neither frequencies nor word counts, so every
+    // matching word counts once and a book's length is its distinct words.
+    // Scores are accumulated over the whole posting lists. Books are
+    // numbered in title order, so ties are broken by book ID.
+    std::vector<RankedBook> search_ranked(const std::vector<std::string>& keywords, size_t k) override {
+        std::vector<std::string> unique(keywords);
+        std::sort(unique.begin(), unique.end());
+        unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+        uint32_t books = snapshot.book_count();
+        double average_length = books == 0 ? 1.0 : std::max(1.0, static_cast<double>(snapshot.total_book_words()) / books);
+        std::unordered_map<uint32_t, double> scores;
+        for (const auto& keyword : unique) {
+            std::optional<uint32_t> id = snapshot.find_word(keyword);
+            if (!id) continue;
+            Snapshot::IdRange list = snapshot.postings(*id);
+            double idf = Bm25::idf(books, list.size());
+            for (uint32_t book : list) {
+                uint32_t length = static_cast<uint32_t>(snapshot.book_words(book).size());
+                scores[book] += Bm25::score(idf, 1, length, average_length);
+            }
+        }
+        std::vector<ScoredDoc> ranked;
+        ranked.reserve(scores.size());
+        for (const auto& [book, score] : scores) {
+            ranked.push_back({static_cast<int>(book), score});
+        }
+        auto better = [](const ScoredDoc& a, const ScoredDoc& b) {
+            return a.score > b.score || (a.score == b.score && a.doc_id < b.doc_id);
+        };
+        size_t kept = std::min(k, ranked.size());
+        std::partial_sort(ranked.begin(), ranked.begin() + kept, ranked.end(), better);
+        std::vector<RankedBook> ans;
+        for (size_t i = 0; i < kept; ++i) {
+            ans.push_back({std::string(snapshot.title(ranked[i].doc_id)), ranked[i].score});
+        }
+        return ans;
+    }
+
+    std::vector<std::string> book_titles() override {
+        std::vector<std::string> ans;
+        ans.reserve(snapshot.book_count());
+        for (uint32_t book = 0; book < snapshot.book_count(); ++book) {
+            ans.emplace_back(snapshot.title(book));
+        }
+        return ans;
+    }
+
+    void print_books() override {
+        for (uint32_t book = 0; book < snapshot.book_count(); ++book) {
+            std::ostringstream oss;
+            Snapshot::IdRange words = snapshot.book_words(book);
+            for (const uint32_t* it = words.begin(); it != words.end(); ++it) {
+                oss << snapshot.word(*it);
+                if (it + 1 != words.end()) oss << " | ";
+            }
+            std::cout << snapshot.title(book) << ": " << oss.str() << std::endl;
         }
-        lib = merge_sort(lib, comp2);
     }
 
     void add_book(const std::string&, const std::vector<std::string>&) override {}
 
+    void remove_book(const std::string&) override {}
+};
+
+inline std::unique_ptr<DigitalLibrary> load_snapshot(const std::string& path, Snapshot::Check check = Snapshot::Check::Header) {
+    return std::make_unique<SnapshotLibrary>(path, check);
+}
+
+// Library that can be queried while books are being added. Queries run
+// lock-free on the published version; every add or remove is applied to a
+// second copy which is then published, so a query sees a whole add_books
+// batch or none of it. Ingest does its work twice and memory is doubled.
+// Writers are serialized against each other, not against other libraries
+// growing their tables at the same time.
+class ConcurrentLibrary : public DigitalLibrary {
+private:
+    using Library = std::unique_ptr<DigitalLibrary>;
+
+    LeftRight<Library> versions;
+
+public:
+    // make() is called twice and must build two empty, identical libraries.
+    explicit ConcurrentLibrary(const std::function<Library()>& make) : versions(make) {}
+
+    // Views point into one version; a later write can reuse it, so callers
+    // that may race with writers should use the copying forms.
+    std::vector<std::string_view> distinct_word_views(const std::string& book_title) override {
+        return versions.read([&](const Library& lib) { return lib->distinct_word_views(book_title); });
+    }
+
+    std::vector<std::string_view> search_keyword_views(const std::string& keyword) override {
+        return versions.read([&](const Library& lib) { return lib->search_keyword_views(keyword); });
+    }
+
     std::vector<std::string> distinct_words(const std::string& book_title) override {
-        int i = 0, j = lib.size() - 1;
-        while (i <= j) {
-            int mid = i + (j - i) / 2;
-            if (lib[mid].first == book_title) {
-                return lib[mid].second;
-            } else if (lib[mid].first < book_title) {
-                i = mid + 1;
+        return versions.read([&](const Library& lib) { return lib->distinct_words(book_title); });
+    }
+
+    int count_distinct_words(const std::string& book_title) override {
+        return versions.read([&](const Library& lib) { return lib->count_distinct_words(book_title); });
+    }
+
+    std::vector<std::string> search_keyword(const std::string& keyword) override {
+        return versions.read([&](const Library& lib) { return lib->search_keyword(keyword); });
+    }
+
+    std::vector<std::vector<std::string>> search_keywords(const std::vector<std::string>& keywords) override {
+        return versions.read([&](const Library& lib) { return lib->search_keywords(keywords); });
+    }
+
+    std::vector<std::string> search_all(const std::vector<std::string>& keywords) override {
+        return versions.read([&](const Library& lib) { return lib->search_all(keywords); });
+    }
+
+    std::vector<std::string> search_any(const std::vector<std::string>& keywords) override {
+        return versions.read([&](const Library& lib) { return lib->search_any(keywords); });
+    }
+
+    std::vector<PrefixMatch> search_prefix(const std::string& prefix, size_t limit) override {
+        return versions.read([&](const Library& lib) { return lib->search_prefix(prefix, limit); });
+    }
+
+    std::vector<RankedBook> search_ranked(const std::vector<std::string>& keywords, size_t k) override {
+        return versions.read([&](const Library& lib) { return lib->search_ranked(keywords, k); });
+    }
+
+    std::vector<std::string> book_titles() override {
+        return versions.read([&](const Library& lib) { return lib->book_titles(); });
+    }
+
+    void print_books() override {
+        versions.read([&](const Library& lib) { lib->print_books(); });
+    }
+
+    void save_snapshot(const std::string& path) override {
+        versions.read([&](const Library& lib) { lib->save_snapshot(path); });
+    }
+
+    void add_book(const std::string& book_title, const std::vector<std::string>& text) override {
+        versions.write([&](Library& lib) { lib->add_book(book_title, text); });
+    }
+
+    void add_books(const std::vector<std::string>& book_titles, const std::vector<std::vector<std::string>>& texts) override {
+        if (book_titles.size() != texts.size()) {
+            throw std::invalid_argument("Every book needs a title and a text");
+        }
+        versions.write([&](Library& lib) { lib->add_books(book_titles, texts); });
+    }
+
+    void remove_book(const std::string& book_title) override {
+        versions.write([&](Library& lib) { lib->remove_book(book_title); });
+    }
+};
+
+// Requests RemoteLibrary sends to serve_library().
+enum class RemoteOp : uint64_t {
+    DistinctWords,
+    CountDistinctWords,
+    SearchKeyword,
+    SearchKeywords,
+    SearchAll,
+    SearchAny,
+    SearchPrefix,
+    SearchRanked,
+    BookTitles,
+    AddBook,
+    AddBooks,
+    AddBookFromFile,
+    RemoveBook
+};
+
+// Answers RemoteOp requests from lib until the other end closes channel.
+// Each reply starts with 0 and the result, or with 1 and the message of the
+// exception the request threw.
+inline void serve_library(Channel& channel, DigitalLibrary& lib) {
+    while (!channel.at_end()) {
+        RemoteOp op = static_cast<RemoteOp>(channel.get_u64());
+        // Arguments are read before the library is called and the status is
+        // put only after it returns, so a failed request leaves nothing
+        // half-written.
+        try {
+            switch (op) {
+            case RemoteOp::DistinctWords: {
+                std::string title = channel.get_string();
+                std::vector<std::string_view> words = lib.distinct_word_views(title);
+                channel.put_u64(0);
+                channel.put_strings(words);
+                break;
+            }
+            case RemoteOp::CountDistinctWords: {
+                std::string title = channel.get_string();
+                int count = lib.count_distinct_words(title);
+                channel.put_u64(0);
+                channel.put_u64(static_cast<uint64_t>(count));
+                break;
+            }
+            case RemoteOp::SearchKeyword: {
+                std::string keyword = channel.get_string();
+                std::vector<std::string_view> titles = lib.search_keyword_views(keyword);
+                channel.put_u64(0);
+                channel.put_strings(titles);
+                break;
+            }
+            case RemoteOp::SearchKeywords: {
+                std::vector<std::vector<std::string>> results = lib.search_keywords(channel.get_strings());
+                channel.put_u64(0);
+                channel.put_u64(results.size());
+                for (const auto& titles : results) {
+                    channel.put_strings(titles);
+                }
+                break;
+            }
+            case RemoteOp::SearchAll:
+            case RemoteOp::SearchAny: {
+                std::vector<std::string> keywords = channel.get_strings();
+                std::vector<std::string> titles = op == RemoteOp::SearchAll ? lib.search_all(keywords) : lib.search_any(keywords);
+                channel.put_u64(0);
+                channel.put_strings(titles);
+                break;
+            }
+            case RemoteOp::SearchPrefix: {
+                std::string prefix = channel.get_string();
+                std::vector<PrefixMatch> matches = lib.search_prefix(prefix, channel.get_u64());
+                channel.put_u64(0);
+                channel.put_u64(matches.size());
+                for (const auto& match : matches) {
+                    channel.put_string(match.word);
+                    channel.put_strings(match.books);
+                }
+                break;
+            }
+            case RemoteOp::SearchRanked: {
+                std::vector<std::string> keywords = channel.get_strings();
+                std::vector<RankedBook> books = lib.search_ranked(keywords, channel.get_u64());
+                channel.put_u64(0);
+                channel.put_u64(books.size());
+                for (const auto& book : books) {
+                    channel.put_string(book.title);
+                    channel.put_double(book.score);
+                }
+                break;
+            }
+            case RemoteOp::BookTitles: {
+                std::vector<std::string> titles = lib.book_titles();
+                channel.put_u64(0);
+                channel.put_strings(titles);
+                break;
+            }
+            case RemoteOp::AddBook: {
+                std::string title = channel.get_string();
+                lib.add_book(title, channel.get_strings());
+                channel.put_u64(0);
+                break;
+            }
+            case RemoteOp::AddBooks: {
+                std::vector<std::string> titles = channel.get_strings();
+                std::vector<std::vector<std::string>> texts(channel.get_u64());
+                for (auto& text : texts) {
+                    text = channel.get_strings();
+                }
+                lib.add_books(titles, texts);
+                channel.put_u64(0);
+                break;
+            }
+            case RemoteOp::AddBookFromFile: {
+                std::string title = channel.get_string();
+                lib.add_book_from_file(title, channel.get_string());
+                channel.put_u64(0);
+                break;
+            }
+            case RemoteOp::RemoveBook:
+                lib.remove_book(channel.get_string());
+                channel.put_u64(0);
+                break;
+            default:
+                throw std::invalid_argument("Unknown library request");
+            }
+        } catch (const std::exception& e) {
+            channel.put_u64(1);
+            channel.put_string(e.what());
+        }
+        channel.send();
+    }
+}
+
+// A library in a worker process: make() runs in the child and every call is
+// forwarded over the worker's socket. Views returned by the *_views methods
+// point into a buffer that the next call reuses.
+class RemoteLibrary : public DigitalLibrary {
+private:
+    WorkerProcess worker;
+    std::vector<std::string> held;
+
+    Channel& request(RemoteOp op) {
+        Channel& channel = worker.channel();
+        channel.put_u64(static_cast<uint64_t>(op));
+        return channel;
+    }
+
+    // Sends the request and reads the status; a failed request rethrows.
+    Channel& reply() {
+        Channel& channel = worker.channel();
+        channel.send();
+        if (channel.get_u64() != 0) {
+            throw std::invalid_argument(channel.get_string());
+        }
+        return channel;
+    }
+
+    std::vector<std::string_view> hold(std::vector<std::string> strings) {
+        held = std::move(strings);
+        return std::vector<std::string_view>(held.begin(), held.end());
+    }
+
+public:
+    explicit RemoteLibrary(const std::function<std::unique_ptr<DigitalLibrary>()>& make)
+        : worker([make](Channel& channel) {
+              std::unique_ptr<DigitalLibrary> lib = make();
+              serve_library(channel, *lib);
+          }) {}
+
+    std::vector<std::string_view> distinct_word_views(const std::string& book_title) override {
+        return hold(distinct_words(book_title));
+    }
+
+    std::vector<std::string> distinct_words(const std::string& book_title) override {
+        request(RemoteOp::DistinctWords).put_string(book_title);
+        return reply().get_strings();
+    }
+
+    int count_distinct_words(const std::string& book_title) override {
+        request(RemoteOp::CountDistinctWords).put_string(book_title);
+        return static_cast<int>(reply().get_u64());
+    }
+
+    std::vector<std::string_view> search_keyword_views(const std::string& keyword) override {
+        return hold(search_keyword(keyword));
+    }
+
+    std::vector<std::string> search_keyword(const std::string& keyword) override {
+        request(RemoteOp::SearchKeyword).put_string(keyword);
+        return reply().get_strings();
+    }
+
+    std::vector<std::vector<std::string>> search_keywords(const std::vector<std::string>& keywords) override {
+        request(RemoteOp::SearchKeywords).put_strings(keywords);
+        Channel& channel = reply();
+        std::vector<std::vector<std::string>> ans(channel.get_u64());
+        for (auto& titles : ans) {
+            titles = channel.get_strings();
+        }
+        return ans;
+    }
+
+    std::vector<std::string> search_all(const std::vector<std::string>& keywords) override {
+        request(RemoteOp::SearchAll).put_strings(keywords);
+        return reply().get_strings();
+    }
+
+    std::vector<std::string> search_any(const std::vector<std::string>& keywords) override {
+        request(RemoteOp::SearchAny).put_strings(keywords);
+        return reply().get_strings();
+    }
+
+    std::vector<PrefixMatch> search_prefix(const std::string& prefix, size_t limit) override {
+        Channel& channel = request(RemoteOp::SearchPrefix);
+        channel.put_string(prefix);
+        channel.put_u64(limit);
+        reply();
+        std::vector<PrefixMatch> ans(channel.get_u64());
+        for (auto& match : ans) {
+            match.word = channel.get_string();
+            match.books = channel.get_strings();
+        }
+        return ans;
+    }
+
+    std::vector<RankedBook> search_ranked(const std::vector<std::string>& keywords, size_t k) override {
+        Channel& channel = request(RemoteOp::SearchRanked);
+        channel.put_strings(keywords);
+        channel.put_u64(k);
+        reply();
+        std::vector<RankedBook> ans(channel.get_u64());
+        for (auto& book : ans) {
+            book.title = channel.get_string();
+            book.score = channel.get_double();
+        }
+        return ans;
+    }
+
+    std::vector<std::string> book_titles() override {
+        request(RemoteOp::BookTitles);
+        return reply().get_strings();
+    }
+
+    // Printed here rather than by the worker, whose stdout buffer is not
+    // ordered with ours.
+    void print_books() override {
+        for (const auto& title : book_titles()) {
+            std::vector<std::string> words = distinct_words(title);
+            std::ostringstream oss;
+            for (size_t i = 0; i < words.size(); ++i) {
+                oss << words[i];
+                if (i < words.size() - 1) oss << " | ";
+            }
+            std::cout << title << ": " << oss.str() << std::endl;
+        }
+    }
+
+    void add_book(const std::string& book_title, const std::vector<std::string>& text) override {
+        Channel& channel = request(RemoteOp::AddBook);
+        channel.put_string(book_title);
+        channel.put_strings(text);
+        reply();
+    }
+
+    void add_books(const std::vector<std::string>& book_titles, const std::vector<std::vector<std::string>>& texts) override {
+        if (book_titles.size() != texts.size()) {
+            throw std::invalid_argument("Every book needs a title and a text");
+        }
+        Channel& channel = request(RemoteOp::AddBooks);
+        channel.put_strings(book_titles);
+        channel.put_u64(texts.size());
+        for (const auto& text : texts) {
+            channel.put_strings(text);
+        }
+        reply();
+    }
+
+    // The worker reads the file itself.
+    void add_book_from_file(const std::string& book_title, const std::string& path) override {
+        Channel& channel = request(RemoteOp::AddBookFromFile);
+        channel.put_string(book_title);
+        channel.put_string(path);
+        reply();
+    }
+
+    void remove_book(const std::string& book_title) override {
+        request(RemoteOp::RemoveBook).put_string(book_title);
+        reply();
+    }
+};
+
+enum class ShardMode {
+    Threads,
+    Processes
+};
+
+// Splits books over shards by a hash of the title. Writes go to the shard
+// owning the title; queries run on every shard at once and the sorted
+// per-shard answers are k-way merged, so results come out as from a single
+// library. search_ranked() merges each shard's top k, scored with that
+// shard's own BM25 statistics, and breaks score ties by title. In
+// Processes mode the library must be built before any other thread starts,
+// as WorkerProcess requires.
+class ShardedLibrary : public DigitalLibrary {
+private:
+    using Library = std::unique_ptr<DigitalLibrary>;
+
+    // Declared before pool: process shards fork before its threads start.
+    std::vector<Library> shards;
+    ThreadPool pool;
+
+    static std::vector<Library> make_shards(int count, const std::function<Library()>& make, ShardMode mode) {
+        std::vector<Library> made;
+        for (int i = 0; i < count; ++i) {
+            if (mode == ShardMode::Processes) {
+                made.push_back(std::make_unique<RemoteLibrary>(make));
             } else {
-                j = mid - 1;
+                made.push_back(make());
             }
         }
-        return {};
+        return made;
+    }
+
+    size_t owner(const std::string& book_title) const {
+        return FastHash::hash(book_title) % shards.size();
+    }
+
+    // f(shard) on every shard in parallel, results in shard order.
+    template <typename F>
+    auto gather(F&& f) {
+        std::vector<decltype(f(*shards[0]))> results(shards.size());
+        pool.parallel_for(shards.size(), [&](size_t s) { results[s] = f(*shards[s]); });
+        return results;
+    }
+
+    // Merges lists each sorted by less into one sorted list.
+    template <typename T, typename Less = std::less<T>>
+    static std::vector<T> merge(std::vector<std::vector<T>>& lists, Less less = Less()) {
+        using Head = std::pair<size_t, size_t>;
+        auto later = [&](const Head& a, const Head& b) { return less(lists[b.first][b.second], lists[a.first][a.second]); };
+        std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+        size_t total = 0;
+        for (size_t l = 0; l < lists.size(); ++l) {
+            total += lists[l].size();
+            if (!lists[l].empty()) heads.push({l, 0});
+        }
+        std::vector<T> merged;
+        merged.reserve(total);
+        while (!heads.empty()) {
+            auto [l, i] = heads.top();
+            heads.pop();
+            merged.push_back(std::move(lists[l][i]));
+            if (i + 1 < lists[l].size()) heads.push({l, i + 1});
+        }
+        return merged;
+    }
+
+public:
+    // Takes over shards, which must be empty or hold only the books that
+    // hash to them.
+    explicit ShardedLibrary(std::vector<Library> shards_)
+        : shards(std::move(shards_)), pool(static_cast<int>(std::max<size_t>(shards.size(), 1))) {
+        if (shards.empty()) {
+            throw std::invalid_argument("A sharded library needs at least one shard");
+        }
+    }
+
+    // count shards built by make(). With ShardMode::Processes each shard is
+    // a RemoteLibrary and make() runs in its worker.
+    ShardedLibrary(int count, const std::function<Library()>& make, ShardMode mode = ShardMode::Threads)
+        : ShardedLibrary(make_shards(count, make, mode)) {}
+
+    size_t shard_count() const {
+        return shards.size();
+    }
+
+    std::vector<std::string_view> distinct_word_views(const std::string& book_title) override {
+        return shards[owner(book_title)]->distinct_word_views(book_title);
+    }
+
+    std::vector<std::string> distinct_words(const std::string& book_title) override {
+        return shards[owner(book_title)]->distinct_words(book_title);
     }
 
     int count_distinct_words(const std::string& book_title) override {
-        auto words = distinct_words(book_title);
-        return words.size();
+        return shards[owner(book_title)]->count_distinct_words(book_title);
+    }
+
+    std::vector<std::string_view> search_keyword_views(const std::string& keyword) override {
+        auto lists = gather([&](DigitalLibrary& shard) { return shard.search_keyword_views(keyword); });
+        return merge(lists);
     }
 
     std::vector<std::string> search_keyword(const std::string& keyword) override {
-        std::vector<std::string> ans;
-        for (const auto& [book, text] : lib) {
-            if (std::binary_search(text.begin(), text.end(), keyword)) {
-                ans.push_back(book);
+        auto lists = gather([&](DigitalLibrary& shard) { return shard.search_keyword(keyword); });
+        return merge(lists);
+    }
+
+    std::vector<std::vector<std::string>> search_keywords(const std::vector<std::string>& keywords) override {
+        auto results = gather([&](DigitalLibrary& shard) { return shard.search_keywords(keywords); });
+        std::vector<std::vector<std::string>> ans(keywords.size());
+        std::vector<std::vector<std::string>> lists(shards.size());
+        for (size_t k = 0; k < keywords.size(); ++k) {
+            for (size_t s = 0; s < shards.size(); ++s) {
+                lists[s] = std::move(results[s][k]);
             }
+            ans[k] = merge(lists);
         }
         return ans;
     }
 
+    std::vector<std::string> search_all(const std::vector<std::string>& keywords) override {
+        auto lists = gather([&](DigitalLibrary& shard) { return shard.search_all(keywords); });
+        return merge(lists);
+    }
+
+    std::vector<std::string> search_any(const std::vector<std::string>& keywords) override {
+        auto lists = gather([&](DigitalLibrary& shard) { return shard.search_any(keywords); });
+        return merge(lists);
+    }
+
+    // Each shard's first `limit` words include every shard's share of the
+    // first `limit` overall; a word found in several shards gets their
+    // books merged.
+    std::vector<PrefixMatch> search_prefix(const std::string& prefix, size_t limit) override {
+        auto lists = gather([&](DigitalLibrary& shard) { return shard.search_prefix(prefix, limit); });
+        std::vector<PrefixMatch> matches = merge(lists, [](const PrefixMatch& a, const PrefixMatch& b) { return a.word < b.word; });
+        std::vector<PrefixMatch> ans;
+        for (size_t i = 0; i < matches.size() && ans.size() < limit;) {
+            std::vector<std::vector<std::string>> books;
+            size_t j = i;
+            for (; j < matches.size() && matches[j].word == matches[i].word; ++j) {
+                books.push_back(std::move(matches[j].books));
+            }
+            ans.push_back({std::move(matches[i].word), merge(books)});
+            i = j;
+        }
+        return ans;
+    }
+
+    std::vector<RankedBook> search_ranked(const std::vector<std::string>& keywords, size_t k) override {
+        auto lists = gather([&](DigitalLibrary& shard) { return shard.search_ranked(keywords, k); });
+        std::vector<RankedBook> ans = merge(lists, [](const RankedBook& a, const RankedBook& b) {
+            return a.score > b.score || (a.score == b.score && a.title < b.title);
+        });
+        if (ans.size() > k) ans.resize(k);
+        return ans;
+    }
+
+    std::vector<std::string> book_titles() override {
+        auto lists = gather([](DigitalLibrary& shard) { return shard.book_titles(); });
+        return merge(lists);
+    }
+
+    // Prints as MuskLibrary does, in title order across all shards.
     void print_books() override {
-        for (const auto& [book, text] : lib) {
+        using Book = std::pair<std::string, std::vector<std::string>>;
+        auto lists = gather([](DigitalLibrary& shard) {
+            std::vector<Book> books;
+            for (auto& title : shard.book_titles()) {
+                std::vector<std::string> words = shard.distinct_words(title);
+                books.emplace_back(std::move(title), std::move(words));
+            }
+            return books;
+        });
+        for (const auto& [book, text] : merge(lists, [](const Book& a, const Book& b) { return a.first < b.first; })) {
             std::ostringstream oss;
             for (size_t i = 0; i < text.size(); ++i) {
                 oss << text[i];
@@ -153,6 +1493,154 @@ public:
             std::cout << book << ": " << oss.str() << std::endl;
         }
     }
+
+    void add_book(const std::string& book_title, const std::vector<std::string>& text) override {
+        shards[owner(book_title)]->add_book(book_title, text);
+    }
+
+    // Each shard gets its books, in their original order, in one call, and
+    // the shards ingest in parallel.
+    void add_books(const std::vector<std::string>& book_titles, const std::vector<std::vector<std::string>>& texts) override {
+        if (book_titles.size() != texts.size()) {
+            throw std::invalid_argument("Every book needs a title and a text");
+        }
+        std::vector<std::vector<std::string>> titles(shards.size());
+        std::vector<std::vector<std::vector<std::string>>> shard_texts(shards.size());
+        for (size_t i = 0; i < book_titles.size(); ++i) {
+            size_t s = owner(book_titles[i]);
+            titles[s].push_back(book_titles[i]);
+            shard_texts[s].push_back(texts[i]);
+        }
+        pool.parallel_for(shards.size(), [&](size_t s) {
+            if (!titles[s].empty()) shards[s]->add_books(titles[s], shard_texts[s]);
+        });
+    }
+
+    void add_book_from_file(const std::string& book_title, const std::string& path) override {
+        shards[owner(book_title)]->add_book_from_file(book_title, path);
+    }
+
+    void remove_book(const std::string& book_title) override {
+        shards[owner(book_title)]->remove_book(book_title);
+    }
+};
+
+// Library that remembers search_keyword() and distinct_words() results in a
+// ResultCache of `budget` bytes. Every add or remove bumps a version, which
+// invalidates all cached results, so answers always match the wrapped
+// library; the inherited search_keywords() goes through the cache keyword
+// by keyword. A hit costs one hash lookup; the copying forms then copy the
+// shared result, while the view methods point into it. Their views hold the
+// result alive only until the next call, which may evict or replace it.
+class CachedLibrary : public DigitalLibrary {
+private:
+    using Library = std::unique_ptr<DigitalLibrary>;
+
+    Library lib;
+    ResultCache cache;
+    uint64_t version;
+    // Key under lookup: a kind byte and the query, reused across calls.
+    std::string probe;
+    // Result the last views point into.
+    ResultCache::Shared held;
+
+    template <typename F>
+    ResultCache::Shared cached(char kind, const std::string& query, F&& compute) {
+        probe.assign(1, kind);
+        probe.append(query);
+        if (ResultCache::Shared result = cache.find(probe, version)) {
+            return result;
+        }
+        auto result = std::make_shared<const std::vector<std::string>>(compute());
+        cache.put(probe, version, result);
+        return result;
+    }
+
+    std::vector<std::string_view> views_of(ResultCache::Shared result) {
+        held = std::move(result);
+        return std::vector<std::string_view>(held->begin(), held->end());
+    }
+
+public:
+    CachedLibrary(Library lib_, size_t budget) : lib(std::move(lib_)), cache(budget), version(0) {}
+
+    // Bumped by every add and remove.
+    uint64_t get_version() const {
+        return version;
+    }
+
+    ResultCache::Stats cache_stats() const {
+        return cache.stats();
+    }
+
+    std::vector<std::string_view> distinct_word_views(const std::string& book_title) override {
+        return views_of(cached('d', book_title, [&]() { return lib->distinct_words(book_title); }));
+    }
+
+    std::vector<std::string_view> search_keyword_views(const std::string& keyword) override {
+        return views_of(cached('k', keyword, [&]() { return lib->search_keyword(keyword); }));
+    }
+
+    std::vector<std::string> distinct_words(const std::string& book_title) override {
+        return *cached('d', book_title, [&]() { return lib->distinct_words(book_title); });
+    }
+
+    std::vector<std::string> search_keyword(const std::string& keyword) override {
+        return *cached('k', keyword, [&]() { return lib->search_keyword(keyword); });
+    }
+
+    int count_distinct_words(const std::string& book_title) override {
+        return lib->count_distinct_words(book_title);
+    }
+
+    std::vector<std::string> search_all(const std::vector<std::string>& keywords) override {
+        return lib->search_all(keywords);
+    }
+
+    std::vector<std::string> search_any(const std::vector<std::string>& keywords) override {
+        return lib->search_any(keywords);
+    }
+
+    std::vector<PrefixMatch> search_prefix(const std::string& prefix, size_t limit) override {
+        return lib->search_prefix(prefix, limit);
+    }
+
+    std::vector<RankedBook> search_ranked(const std::vector<std::string>& keywords, size_t k) override {
+        return lib->search_ranked(keywords, k);
+    }
+
+    std::vector<std::string> book_titles() override {
+        return lib->book_titles();
+    }
+
+    void print_books() override {
+        lib->print_books();
+    }
+
+    void save_snapshot(const std::string& path) override {
+        lib->save_snapshot(path);
+    }
+
+    // The version is bumped even if the write throws part way through.
+    void add_book(const std::string& book_title, const std::vector<std::string>& text) override {
+        version++;
+        lib->add_book(book_title, text);
+    }
+
+    void add_books(const std::vector<std::string>& book_titles, const std::vector<std::vector<std::string>>& texts) override {
+        version++;
+        lib->add_books(book_titles, texts);
+    }
+
+    void add_book_from_file(const std::string& book_title, const std::string& path) override {
+        version++;
+        lib->add_book_from_file(book_title, path);
+    }
+
+    void remove_book(const std::string& book_title) override {
+        version++;
+        lib->remove_book(book_title);
+    }
 };
 
-#endif
+#endif
\ No newline at end of file
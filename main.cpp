@@ -1,9 +1,22 @@
 #include "library.hpp"
+#include "benchmark.hpp"
 #include <iostream>
 #include <vector>
 #include <string>
 #include <chrono>
 #include <map>
+#include <set>
+#include <random>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <filesystem>
+#include <fstream>
+#include <cctype>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <cmath>
 
 void check_lib(DigitalLibrary* lib, const std::vector<std::vector<std::string>>& unique_words,
                const std::map<std::string, std::vector<std::string>>& word_to_books) {
@@ -29,6 +42,1273 @@ void check_lib(DigitalLibrary* lib, const std::vector<std::vector<std::string>>&
     std::cout << "\n\n";
 }
 
+void report(const std::string& check, bool ok) {
+    std::cout << check << (ok ? " CORRECT!" : " FAILED!") << std::endl;
+}
+
+std::vector<std::string> numbered_words(const std::string& stem, int count) {
+    std::vector<std::string> words;
+    for (int i = 0; i < count; ++i) {
+        words.push_back(stem + std::to_string(i));
+    }
+    return words;
+}
+
+const std::vector<std::string> COLLISION_TYPES = {"Linear", "Double", "Chain", "Swiss", "RobinHood"};
+
+// Whether table holds exactly the keys of reference among keys.
+template <typename Table>
+bool matches(const Table& table, const std::set<std::string>& reference, const std::vector<std::string>& keys) {
+    for (const auto& key : keys) {
+        if (table.find(key).has_value() != (reference.count(key) > 0)) return false;
+    }
+    return table.get_size() == static_cast<int>(reference.size());
+}
+
+// Grows a set and a map of each collision type in both rehash modes,
+// checking every key after each insert made while old storage was still
+// being drained. Only the layouts that migrate incrementally drain.
+void check_rehash_modes() {
+    std::vector<std::string> words = numbered_words("w", 400);
+    for (const auto& type : COLLISION_TYPES) {
+        for (RehashMode mode : {RehashMode::Full, RehashMode::Incremental}) {
+            std::string name = type + (mode == RehashMode::Full ? " FULL" : " INCREMENTAL");
+            DynamicHashSet set(type, {10, 37, 7, 13}, mode);
+            DynamicHashMap<int> map(type, {10, 37, 7, 13}, mode);
+            std::set<std::string> reference;
+            bool ok = true;
+            bool drained = false;
+            for (size_t i = 0; i < words.size(); ++i) {
+                set.insert(words[i]);
+                map.insert({words[i], static_cast<int>(i)});
+                reference.insert(words[i]);
+                if (set.is_rehashing() || map.is_rehashing()) {
+                    drained = true;
+                    ok = ok && matches(set, reference, words) && matches(map, reference, words);
+                    for (size_t j = 0; j <= i && ok; ++j) {
+                        const int* value = map.find_ptr(words[j]);
+                        ok = value != nullptr && *value == static_cast<int>(j);
+                    }
+                }
+            }
+            bool should_drain = mode == RehashMode::Incremental && type != "Swiss" && type != "RobinHood";
+            ok = ok && drained == should_drain && matches(set, reference, words) && matches(map, reference, words) &&
+                 !set.find("absent").has_value() && map.find_ptr("absent") == nullptr;
+            report(name + " INSERT/FIND", ok);
+        }
+    }
+    std::cout << "\n\n";
+}
+
+// Erases while growing, in both rehash modes, so some erases hit storage
+// being drained, then puts the erased keys back. Tombstones must stay
+// below a quarter of the slots, and Linear probing must leave none in its
+// current storage as erase shifts the cluster back instead.
+void check_erase() {
+    std::vector<std::string> words = numbered_words("w", 400);
+    for (const auto& type : COLLISION_TYPES) {
+        for (RehashMode mode : {RehashMode::Full, RehashMode::Incremental}) {
+            std::string name = type + (mode == RehashMode::Full ? " FULL" : " INCREMENTAL");
+            DynamicHashSet set(type, {10, 37, 7, 13}, mode);
+            DynamicHashMap<int> map(type, {10, 37, 7, 13}, mode);
+            std::set<std::string> reference;
+            bool ok = !set.erase("absent") && !map.erase("absent");
+            auto clean = [&]() {
+                TableStats stats = set.stats();
+                bool shifted = (type != "Linear" && type != "RobinHood") || set.is_rehashing() || stats.tombstones == 0;
+                return shifted && stats.tombstones * 4 < stats.capacity && map.stats().tombstones * 4 < map.get_capacity();
+            };
+            for (size_t i = 0; i < words.size(); ++i) {
+                set.insert(words[i]);
+                map.insert({words[i], static_cast<int>(i)});
+                reference.insert(words[i]);
+                if (i % 3 == 0) {
+                    bool expected = reference.erase(words[i / 2]) > 0;
+                    ok = ok && set.erase(words[i / 2]) == expected && map.erase(words[i / 2]) == expected;
+                }
+                if (set.is_rehashing() || map.is_rehashing()) {
+                    ok = ok && matches(set, reference, words) && matches(map, reference, words);
+                }
+                ok = ok && clean();
+            }
+            ok = ok && matches(set, reference, words) && matches(map, reference, words);
+            for (size_t i = 0; i < words.size(); ++i) {
+                set.insert(words[i]);
+                map.insert({words[i], static_cast<int>(i)});
+            }
+            reference.insert(words.begin(), words.end());
+            ok = ok && matches(set, reference, words) && matches(map, reference, words) && clean();
+            for (size_t i = 0; i < words.size() && ok; ++i) {
+                ok = *map.find_ptr(words[i]) == static_cast<int>(i);
+            }
+            report(name + " ERASE", ok);
+        }
+    }
+
+    // A fixed-size table that never grows must clear its own tombstones.
+    std::vector<std::string> churn = numbered_words("c", 300);
+    for (const auto& type : COLLISION_TYPES) {
+        HashSet set(type, {10, 37, 7, 13});
+        std::set<std::string> reference;
+        bool ok = true;
+        for (size_t i = 0; i < churn.size() && ok; ++i) {
+            if (i >= 6) {
+                ok = set.erase(churn[i - 6]) && !set.erase(churn[i - 6]);
+                reference.erase(churn[i - 6]);
+            }
+            set.insert({churn[i], churn[i]});
+            reference.insert(churn[i]);
+            TableStats stats = set.stats();
+            ok = ok && stats.tombstones * 4 < stats.capacity && matches(set, reference, churn);
+        }
+        report(type + " TOMBSTONE CLEANUP", ok);
+    }
+    std::cout << "\n\n";
+}
+
+// Random inserts and erases over a small key space against a std::set
+// reference, checking the touched key after every operation.
+void check_churn(const std::string& type) {
+    std::vector<std::string> keys = numbered_words("k", 500);
+    DynamicHashSet set(type, {10, 37, 7, 13});
+    std::set<std::string> reference;
+    std::mt19937 random(7);
+    bool ok = true;
+    for (int op = 0; op < 5000 && ok; ++op) {
+        const std::string& key = keys[random() % keys.size()];
+        if (random() % 3 == 0) {
+            ok = set.erase(key) == (reference.erase(key) > 0);
+        } else {
+            set.insert(key);
+            reference.insert(key);
+        }
+        ok = ok && set.find(key).has_value() == (reference.count(key) > 0);
+    }
+    report(type + " CHURN", ok && matches(set, reference, keys));
+}
+
+// Random inserts and erases over a small key space, at several max loads,
+// against a std::set reference. The load must stay below the max load, and
+// a max load outside (0, 1) is rejected.
+void check_max_loads(const std::string& type) {
+    std::vector<std::string> keys = numbered_words("k", 500);
+    for (double max_load : {0.5, 0.75, 0.9}) {
+        DynamicHashSet set(type, {10, 37, 7, 13}, RehashMode::Full, HashFunction::Polynomial, Growth::Prime, max_load);
+        std::set<std::string> reference;
+        std::mt19937 random(7);
+        bool ok = set.get_max_load() == max_load;
+        for (int op = 0; op < 5000 && ok; ++op) {
+            const std::string& key = keys[random() % keys.size()];
+            if (random() % 3 == 0) {
+                ok = set.erase(key) == (reference.erase(key) > 0);
+            } else {
+                set.insert(key);
+                reference.insert(key);
+            }
+            ok = ok && set.get_load() < max_load && set.contains(key) == (reference.count(key) > 0);
+        }
+        ok = ok && matches(set, reference, keys);
+        report(type + " AT MAX LOAD " + std::to_string(max_load).substr(0, 4), ok);
+    }
+    bool rejected = true;
+    for (double max_load : {0.0, 1.0, -0.5, 1.5}) {
+        try {
+            DynamicHashSet set(type, {10, 37, 7, 13}, RehashMode::Full, HashFunction::Polynomial, Growth::Prime, max_load);
+            rejected = false;
+        } catch (const std::invalid_argument&) {
+        }
+    }
+    report(type + " INVALID MAX LOAD", rejected);
+}
+
+// Tables that keep their own growth state, growing past several sizes while
+// erasing, in both rehash modes, and a table on the shared list. Every
+// capacity must come from the policy: a power of two, or a growth prime.
+// Double probing in a power-of-two table relies on an odd step to reach
+// every slot.
+void check_growth() {
+    std::vector<std::string> words = numbered_words("g", 3000);
+    auto is_growth_prime = [](int capacity) {
+        return std::find(std::begin(PrimeGenerator::GROWTH_PRIMES), std::end(PrimeGenerator::GROWTH_PRIMES), capacity) !=
+               std::end(PrimeGenerator::GROWTH_PRIMES);
+    };
+    for (Growth growth : {Growth::Prime, Growth::PowerOfTwo}) {
+        for (const auto& type : COLLISION_TYPES) {
+            bool ok = true;
+            for (RehashMode mode : {RehashMode::Full, RehashMode::Incremental}) {
+                for (HashFunction hash_function : {HashFunction::Polynomial, HashFunction::Fast}) {
+                    DynamicHashSet set(type, {10, 37, 7, 13}, mode, hash_function, growth);
+                    DynamicHashMap<int> map(type, {10, 37, 7, 13}, mode, hash_function, growth);
+                    std::set<std::string> reference;
+                    auto sized = [&](int capacity) {
+                        bool power_of_two = (capacity & (capacity - 1)) == 0;
+                        return growth == Growth::PowerOfTwo || type == "Swiss" ? power_of_two
+                                                                               : capacity == 13 || is_growth_prime(capacity);
+                    };
+                    for (size_t i = 0; i < words.size() && ok; ++i) {
+                        set.insert(words[i]);
+                        map.insert({words[i], static_cast<int>(i)});
+                        reference.insert(words[i]);
+                        if (i % 3 == 0) {
+                            bool expected = reference.erase(words[i / 2]) > 0;
+                            ok = set.erase(words[i / 2]) == expected && map.erase(words[i / 2]) == expected;
+                        }
+                        ok = ok && sized(set.get_capacity()) && sized(map.get_capacity());
+                        if (i % 97 == 0) {
+                            ok = ok && matches(set, reference, words) && matches(map, reference, words);
+                        }
+                    }
+                    ok = ok && matches(set, reference, words) && matches(map, reference, words) && set.get_capacity() > 1000;
+                    for (const auto& key : reference) {
+                        const int* value = map.find_ptr(key);
+                        ok = ok && value != nullptr && words[*value] == key;
+                    }
+                }
+            }
+            report(type + (growth == Growth::Prime ? " PRIME" : " POWER OF TWO") + " GROWTH", ok);
+        }
+    }
+
+    // Shared tables pop the process-wide list, last entry first, and fail
+    // once it runs out.
+    PrimeGenerator::set_primes({97, 53});
+    DynamicHashSet shared("Linear", {10, 29}, RehashMode::Full, HashFunction::Polynomial, Growth::Shared);
+    std::vector<int> capacities;
+    bool exhausted = false;
+    try {
+        for (const auto& word : words) {
+            shared.insert(word);
+            if (capacities.empty() || capacities.back() != shared.get_capacity()) capacities.push_back(shared.get_capacity());
+        }
+    } catch (const std::invalid_argument&) {
+        exhausted = true;
+    }
+    report("SHARED GROWTH", exhausted && capacities == std::vector<int>{29, 53, 97});
+    std::cout << "\n\n";
+}
+
+// Whether a frozen copy answers contains, find and get_slot for every key
+// exactly like its source, even for keys still being drained. Absent keys
+// have no insertion point once frozen and report -1 under open addressing.
+template <typename Source, typename Frozen>
+bool same_answers(const Source& source, const Frozen& frozen, const std::vector<std::string>& keys) {
+    for (const auto& key : keys) {
+        if (frozen.contains(key) != source.contains(key) || frozen.find(key) != source.find(key)) return false;
+        auto slot = source.get_slot(key);
+        if (!source.contains(key) && std::holds_alternative<int>(slot)) slot = -1;
+        if (frozen.get_slot(key) != slot) return false;
+    }
+    return true;
+}
+
+// Freezes sets and maps of every collision type after each insert and
+// erase, so some copies are taken mid-migration, and compares them with the
+// source. Mid-migration copies must occur for the layouts that migrate
+// incrementally, Chain included.
+void check_freeze() {
+    std::vector<std::string> words = numbered_words("w", 300);
+    std::vector<std::string> keys = numbered_words("w", 400);
+    for (const auto& type : COLLISION_TYPES) {
+        for (RehashMode mode : {RehashMode::Full, RehashMode::Incremental}) {
+            std::string name = type + (mode == RehashMode::Full ? " FULL" : " INCREMENTAL");
+            DynamicHashSet set(type, {10, 37, 7, 13}, mode);
+            DynamicHashMap<int> map(type, {10, 37, 7, 13}, mode);
+            bool ok = true;
+            bool drained = false;
+            for (size_t i = 0; i < words.size() && ok; ++i) {
+                set.insert(words[i]);
+                map.insert({words[i], static_cast<int>(i)});
+                if (i % 7 == 0) {
+                    set.erase(words[i / 2]);
+                    map.erase(words[i / 2]);
+                }
+                drained = drained || set.is_rehashing() || map.is_rehashing();
+                ok = same_answers(set, set.freeze(), keys) && same_answers(map, map.freeze(), keys);
+            }
+            bool should_drain = mode == RehashMode::Incremental && type != "Swiss" && type != "RobinHood";
+            report(name + " FREEZE", ok && drained == should_drain);
+        }
+    }
+    std::cout << "\n\n";
+}
+
+// Whether find_batch over keys agrees with find on each key, for a set and
+// a map whose values are the key's index in words.
+bool same_batch(const DynamicHashSet& set, const DynamicHashMap<int>& map, const std::vector<std::string>& keys) {
+    std::vector<std::string_view> views(keys.begin(), keys.end());
+    std::vector<bool> found;
+    std::vector<const int*> values;
+    set.find_batch(views, found);
+    map.find_batch(views, values);
+    if (found.size() != keys.size() || values.size() != keys.size()) return false;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (found[i] != set.find(keys[i]).has_value() || values[i] != map.find_ptr(keys[i])) return false;
+    }
+    set.find_batch({}, found);
+    return found.empty();
+}
+
+// Batched lookups of present and absent keys, many more than one group,
+// against single lookups: after every insert that leaves a table draining
+// its old storage, and once the table is settled.
+void check_find_batch() {
+    std::vector<std::string> words = numbered_words("w", 400);
+    std::vector<std::string> keys = numbered_words("w", 500);
+    for (const auto& type : COLLISION_TYPES) {
+        for (RehashMode mode : {RehashMode::Full, RehashMode::Incremental}) {
+            for (HashFunction hash_function : {HashFunction::Polynomial, HashFunction::Fast}) {
+                DynamicHashSet set(type, {10, 37, 7, 13}, mode, hash_function);
+                DynamicHashMap<int> map(type, {10, 37, 7, 13}, mode, hash_function);
+                bool ok = same_batch(set, map, keys);
+                for (size_t i = 0; i < words.size() && ok; ++i) {
+                    set.insert(words[i]);
+                    map.insert({words[i], static_cast<int>(i)});
+                    if (i % 3 == 0) set.erase(words[i / 2]);
+                    if (set.is_rehashing() || map.is_rehashing() || i + 1 == words.size()) {
+                        ok = same_batch(set, map, keys);
+                    }
+                }
+                std::string name = type + (mode == RehashMode::Full ? " FULL" : " INCREMENTAL");
+                report(name + (hash_function == HashFunction::Fast ? " FAST" : "") + " FIND BATCH", ok);
+            }
+        }
+    }
+    std::cout << "\n\n";
+}
+
+uint64_t total(const std::vector<uint64_t>& histogram) {
+    uint64_t sum = 0;
+    for (uint64_t count : histogram) {
+        sum += count;
+    }
+    return sum;
+}
+
+// stats() of a set of each collision type grown through several resizes.
+// The snapshot fields always hold. The counters only move in a build with
+// -DHASH_TABLE_STATS, where each find must add one probe to the hit or miss
+// histogram; otherwise they must stay empty.
+void check_stats() {
+#if defined(HASH_TABLE_STATS)
+    const bool counting = true;
+#else
+    const bool counting = false;
+#endif
+    std::vector<std::string> words = numbered_words("w", 400);
+    std::vector<std::string> absent = numbered_words("absent", 100);
+    for (const auto& type : COLLISION_TYPES) {
+        for (RehashMode mode : {RehashMode::Full, RehashMode::Incremental}) {
+            DynamicHashSet set(type, {10, 37, 7, 13}, mode);
+            for (const auto& word : words) {
+                set.insert(word);
+            }
+            set.finish_rehash();
+            TableStats before = set.stats();
+            for (const auto& word : words) {
+                set.find(word);
+            }
+            for (const auto& word : absent) {
+                set.find(word);
+            }
+            TableStats after = set.stats();
+            bool ok = after.counting == counting && after.size == 400 && after.capacity == set.get_capacity() &&
+                      after.load == set.get_load() && after.tombstones == 0;
+            if (type == "Chain") {
+                uint64_t entries = 0;
+                for (size_t k = 0; k < after.chain_lengths.size(); ++k) {
+                    entries += k * after.chain_lengths[k];
+                }
+                ok = ok && total(after.chain_lengths) == static_cast<uint64_t>(after.capacity) && entries == 400;
+            }
+            uint64_t hits = total(after.hit_probes) - total(before.hit_probes);
+            uint64_t misses = total(after.miss_probes) - total(before.miss_probes);
+            if (counting) {
+                ok = ok && hits == words.size() && misses == absent.size() && after.key_compares >= before.key_compares + 400 &&
+                     before.rehashes > 0 && before.bytes_moved > 0 && after.rehashes == before.rehashes;
+            } else {
+                ok = ok && after.hit_probes.empty() && after.miss_probes.empty() && after.key_compares == 0 &&
+                     after.rehashes == 0 && after.rehash_seconds == 0 && after.bytes_moved == 0;
+            }
+            report(type + (mode == RehashMode::Full ? " FULL" : " INCREMENTAL") + (counting ? " COUNTED" : "") + " STATS", ok);
+        }
+    }
+    std::cout << "\n\n";
+}
+
+// Interning the same text again, from another buffer, must give back the
+// same ID and view. Views must stay put while the arena grows, by whole
+// chunks and by strings too long to share one.
+void check_string_pool() {
+    std::vector<std::string> words = numbered_words("s", 20000);
+    words.push_back(std::string(StringPool::CHUNK_SIZE, 'L'));
+    words.push_back("");
+    StringPool pool;
+    std::vector<std::string_view> views;
+    bool ok = true;
+    for (size_t i = 0; i < words.size(); ++i) {
+        uint32_t id = pool.intern(words[i]);
+        ok = ok && id == i;
+        views.push_back(pool.view(id));
+    }
+    for (size_t i = 0; i < words.size() && ok; ++i) {
+        std::string copy = words[i];
+        uint32_t id = static_cast<uint32_t>(i);
+        ok = pool.intern(copy) == id && pool.find(copy) == id && pool.view(id).data() == views[i].data() && views[i] == words[i];
+    }
+    report("STRING POOL INTERNING", ok && pool.size() == words.size() && !pool.find("absent").has_value());
+}
+
+// Keys the Fast hash reads in 8-byte words and tails of every length:
+// short, long, sharing long prefixes, punctuation, UTF-8 and the empty key.
+std::vector<std::string> awkward_keys() {
+    std::vector<std::string> keys = numbered_words("w", 150);
+    for (int i = 0; i < 40; ++i) {
+        keys.push_back(std::string(i, 'x'));
+        keys.push_back(std::string(i, 'x') + "!");
+        keys.push_back(std::string(24, 'p') + std::to_string(i));
+    }
+    for (const std::string key : {"a.b", "a,b", "don't", "naïve", "日本語", "ü", "\t"}) {
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+// Sets and maps hashed with HashFunction::Fast against a std::set, in both
+// rehash modes and in a fixed-size table. Only even keys are inserted, so
+// every odd one must be absent.
+void check_fast_hash() {
+    std::vector<std::string> keys = awkward_keys();
+    for (const auto& type : COLLISION_TYPES) {
+        for (RehashMode mode : {RehashMode::Full, RehashMode::Incremental}) {
+            DynamicHashSet set(type, {10, 37, 7, 13}, mode, HashFunction::Fast);
+            DynamicHashMap<int> map(type, {10, 37, 7, 13}, mode, HashFunction::Fast);
+            std::set<std::string> reference;
+            bool ok = true;
+            for (size_t i = 0; i < keys.size(); i += 2) {
+                set.insert(keys[i]);
+                map.insert({keys[i], static_cast<int>(i)});
+                reference.insert(keys[i]);
+                ok = ok && matches(set, reference, keys) && matches(map, reference, keys);
+            }
+            std::vector<std::string> stored = set.keys();
+            std::sort(stored.begin(), stored.end());
+            ok = ok && stored == std::vector<std::string>(reference.begin(), reference.end());
+            report(type + (mode == RehashMode::Full ? " FULL" : " INCREMENTAL") + " FAST HASH", ok);
+        }
+        HashSet fixed(type, {10, 37, 7, 509}, HashFunction::Fast);
+        std::set<std::string> reference;
+        for (size_t i = 0; i < keys.size(); i += 2) {
+            fixed.insert({keys[i], keys[i]});
+            reference.insert(keys[i]);
+        }
+        report(type + " FIXED FAST HASH", matches(fixed, reference, keys));
+    }
+    std::cout << "\n\n";
+}
+
+// StringSort against std::sort on inputs of every size up to well past the
+// insertion sort cutoff: many duplicates, empty strings, long shared
+// prefixes, prefixes of other strings and bytes above 0x7F, as strings and
+// as views. Keyed sorts must order items by key, whatever they do with
+// equal keys.
+void check_string_sort() {
+    std::mt19937 random(13);
+    bool ok = true;
+    for (size_t n : {0, 1, 2, 3, 15, 16, 17, 40, 1000}) {
+        std::vector<std::string> items;
+        for (size_t i = 0; i < n; ++i) {
+            std::string s = random() % 2 ? std::string(20, 'p') : "";
+            size_t length = random() % 5;
+            for (size_t c = 0; c < length; ++c) {
+                s += "ab\xC3\xFF"[random() % 4];
+            }
+            items.push_back(s);
+        }
+        std::vector<std::string> expected = items;
+        std::sort(expected.begin(), expected.end());
+        std::vector<std::string> sorted = items;
+        StringSort::sort(sorted);
+        ok = ok && sorted == expected;
+
+        std::vector<std::string_view> views(items.begin(), items.end());
+        StringSort::sort(views);
+        ok = ok && std::vector<std::string>(views.begin(), views.end()) == expected;
+
+        std::vector<std::string> unique = items;
+        StringSort::sort_unique(unique);
+        expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+        ok = ok && unique == expected;
+
+        std::vector<std::pair<std::string, size_t>> pairs;
+        for (size_t i = 0; i < items.size(); ++i) {
+            pairs.push_back({items[i], i});
+        }
+        StringSort::sort(pairs, [](const std::pair<std::string, size_t>& p) -> const std::string& { return p.first; });
+        for (size_t i = 0; i < pairs.size() && ok; ++i) {
+            ok = pairs[i].first == sorted[i] && items[pairs[i].second] == pairs[i].first;
+        }
+    }
+    report("STRING SORT", ok);
+}
+
+struct Corpus {
+    std::vector<std::string> titles;
+    std::vector<std::vector<std::string>> texts;
+    std::vector<std::string> vocabulary;
+};
+
+// Books of random words from a small vocabulary, the same for a given seed.
+Corpus make_corpus(int books, int length, uint32_t seed) {
+    Corpus corpus;
+    corpus.vocabulary = numbered_words("v", 60);
+    std::mt19937 random(seed);
+    for (int b = 0; b < books; ++b) {
+        corpus.titles.push_back("title" + std::to_string(random() % 1000) + "_" + std::to_string(b));
+        std::vector<std::string> text;
+        for (int w = 0; w < length; ++w) {
+            text.push_back(corpus.vocabulary[random() % (1 + random() % corpus.vocabulary.size())]);
+        }
+        corpus.texts.push_back(text);
+    }
+    return corpus;
+}
+
+// search_keyword, search_all and search_any of lib for every word and pair
+// of words of the vocabulary, a word in no book and no words at all, and
+// search_prefix for a few prefixes and limits, against sets of titles built
+// straight from the texts.
+bool same_searches(DigitalLibrary& lib, const Corpus& corpus) {
+    std::map<std::string, std::set<std::string>> books;
+    for (size_t b = 0; b < corpus.titles.size(); ++b) {
+        for (const auto& word : corpus.texts[b]) {
+            books[word].insert(corpus.titles[b]);
+        }
+    }
+    auto titles = [&](const std::string& word) {
+        auto it = books.find(word);
+        return it == books.end() ? std::vector<std::string>() : std::vector<std::string>(it->second.begin(), it->second.end());
+    };
+    std::vector<std::string> words = corpus.vocabulary;
+    words.push_back("absent");
+    if (!lib.search_all({}).empty() || !lib.search_any({}).empty() || !lib.search_keywords({}).empty()) return false;
+    std::vector<std::vector<std::string>> batch = lib.search_keywords(words);
+    if (batch.size() != words.size()) return false;
+    for (size_t i = 0; i < words.size(); ++i) {
+        std::vector<std::string> a = titles(words[i]);
+        if (lib.search_keyword(words[i]) != a || batch[i] != a || lib.search_all({words[i]}) != a || lib.search_any({words[i]}) != a) {
+            return false;
+        }
+        for (size_t j = i + 1; j < words.size(); ++j) {
+            std::vector<std::string> b = titles(words[j]);
+            std::vector<std::string> both;
+            std::vector<std::string> either;
+            std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(both));
+            std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(either));
+            std::vector<std::string> pair = {words[i], words[j], words[i]};
+            if (lib.search_all(pair) != both || lib.search_any(pair) != either) return false;
+        }
+    }
+    for (const std::string prefix : {"", "v", "v1", "v5", "v59", "x", "absent"}) {
+        for (size_t limit : {0, 1, 3, 100}) {
+            std::vector<PrefixMatch> found = lib.search_prefix(prefix, limit);
+            auto it = books.lower_bound(prefix);
+            for (const auto& match : found) {
+                if (it == books.end() || it->first.compare(0, prefix.size(), prefix) != 0 || match.word != it->first ||
+                    match.books != titles(it->first)) {
+                    return false;
+                }
+                ++it;
+            }
+            bool more = it != books.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+            if (found.size() > limit || (more && found.size() < limit)) return false;
+        }
+    }
+    return true;
+}
+
+// Keeps every third book of corpus and removes the others from lib, enough
+// that the library renumbers its books.
+Corpus remove_most(DigitalLibrary& lib, const Corpus& corpus) {
+    Corpus kept;
+    kept.vocabulary = corpus.vocabulary;
+    for (size_t b = 0; b < corpus.titles.size(); ++b) {
+        if (b % 3 == 0) {
+            kept.titles.push_back(corpus.titles[b]);
+            kept.texts.push_back(corpus.texts[b]);
+        } else {
+            lib.remove_book(corpus.titles[b]);
+        }
+    }
+    lib.remove_book("missing");
+    return kept;
+}
+
+// Every library against the brute-force answers, before and after most
+// books are removed. JGBLibrary also gets one book added again with another
+// text, whose old words must stop matching.
+void check_searches() {
+    Corpus corpus = make_corpus(30, 40, 3);
+    MuskLibrary musk(corpus.titles, corpus.texts);
+    report("Musk SEARCH", same_searches(musk, corpus));
+    Corpus kept = remove_most(musk, corpus);
+    report("Musk SEARCH AFTER REMOVE", same_searches(musk, kept) && musk.distinct_words(corpus.titles[1]).empty() &&
+                                           musk.count_distinct_words(corpus.titles[1]) == 0);
+    for (const std::string name : {"Jobs", "Gates", "Bezos"}) {
+        for (HashFunction hash_function : {HashFunction::Polynomial, HashFunction::Fast}) {
+            JGBLibrary lib(name, {10, 37, 7, 13}, hash_function);
+            for (size_t b = 0; b < corpus.titles.size(); ++b) {
+                lib.add_book(corpus.titles[b], corpus.texts[b]);
+            }
+            Corpus readded = corpus;
+            readded.texts[5] = {"v58", "v59", "v59"};
+            lib.add_book(readded.titles[5], readded.texts[5]);
+            std::string label = name + (hash_function == HashFunction::Fast ? " FAST" : "");
+            report(label + " SEARCH", same_searches(lib, readded));
+            Corpus kept = remove_most(lib, readded);
+            report(label + " SEARCH AFTER REMOVE", same_searches(lib, kept) && lib.distinct_words(corpus.titles[1]).empty() &&
+                                                       lib.count_distinct_words(corpus.titles[1]) == 0);
+            for (size_t b = 0; b < readded.titles.size(); ++b) {
+                if (b % 3 != 0) lib.add_book(readded.titles[b], readded.texts[b]);
+            }
+            report(label + " SEARCH AFTER RE-ADD", same_searches(lib, readded));
+        }
+    }
+    std::cout << "\n\n";
+}
+
+// The view forms against sets built straight from the texts. Views of
+// pooled words point into the pool's arena, so inserts of other words into
+// the same set, pool or library, which grow both, must leave them readable
+// and unchanged.
+void check_views() {
+    bool ok = true;
+    for (const auto& type : COLLISION_TYPES) {
+        for (RehashMode mode : {RehashMode::Full, RehashMode::Incremental}) {
+            StringPool pool;
+            DynamicWordSet set(type, {10, 37, 7, 13}, mode);
+            DynamicHashMap<int> map(type, {10, 37, 7, 13}, mode);
+            std::vector<std::string> words = numbered_words("w", 100);
+            for (size_t i = 0; i < words.size(); ++i) {
+                set.insert(pool.view(pool.intern(words[i])));
+                map.insert({words[i], static_cast<int>(i)});
+            }
+            std::vector<std::string_view> views = set.views();
+            std::sort(views.begin(), views.end());
+            std::vector<std::string> expected = words;
+            std::sort(expected.begin(), expected.end());
+            for (const auto& word : numbered_words("unrelated", 5000)) {
+                set.insert(pool.view(pool.intern(word)));
+            }
+            ok = ok && std::vector<std::string>(views.begin(), views.end()) == expected;
+            for (size_t i = 0; i < words.size() && ok; ++i) {
+                ok = set.contains(words[i]) && map.contains(words[i]) && map.find_ref(words[i]) == static_cast<int>(i);
+            }
+            bool thrown = false;
+            try {
+                map.find_ref("absent");
+            } catch (const std::invalid_argument&) {
+                thrown = true;
+            }
+            ok = ok && thrown && !set.contains("absent") && !map.contains("absent");
+        }
+    }
+    report("TABLE VIEWS", ok);
+
+    Corpus corpus = make_corpus(30, 40, 9);
+    MuskLibrary musk(corpus.titles, corpus.texts);
+    std::map<std::string, std::set<std::string>> books;
+    for (size_t b = 0; b < corpus.titles.size(); ++b) {
+        for (const auto& word : corpus.texts[b]) {
+            books[word].insert(corpus.titles[b]);
+        }
+    }
+    auto same_views = [&](DigitalLibrary& lib) {
+        for (size_t b = 0; b < corpus.titles.size(); ++b) {
+            std::set<std::string> unique(corpus.texts[b].begin(), corpus.texts[b].end());
+            std::vector<std::string_view> words = lib.distinct_word_views(corpus.titles[b]);
+            if (std::vector<std::string>(words.begin(), words.end()) != std::vector<std::string>(unique.begin(), unique.end())) {
+                return false;
+            }
+        }
+        for (const auto& [word, titles] : books) {
+            std::vector<std::string_view> views = lib.search_keyword_views(word);
+            if (std::vector<std::string>(views.begin(), views.end()) != std::vector<std::string>(titles.begin(), titles.end())) {
+                return false;
+            }
+        }
+        return lib.distinct_word_views("missing").empty() && lib.search_keyword_views("absent").empty();
+    };
+    report("Musk VIEWS", same_views(musk));
+    for (const std::string name : {"Jobs", "Gates", "Bezos"}) {
+        JGBLibrary lib(name, {10, 37, 7, 13});
+        for (size_t b = 0; b < corpus.titles.size(); ++b) {
+            lib.add_book(corpus.titles[b], corpus.texts[b]);
+        }
+        bool ok = same_views(lib);
+        std::vector<std::string_view> views = lib.distinct_word_views(corpus.titles[0]);
+        std::vector<std::string> words = lib.distinct_words(corpus.titles[0]);
+        for (int b = 0; b < 200; ++b) {
+            lib.add_book("unrelated" + std::to_string(b), numbered_words("u" + std::to_string(b) + "_", 50));
+        }
+        ok = ok && std::vector<std::string>(views.begin(), views.end()) == words;
+        report(name + " VIEWS AFTER UNRELATED ADDS", ok);
+    }
+}
+
+// MuskLibrary in both search modes against the brute-force answers and on
+// words in no book, before and after removals compact the catalog and
+// rebuild the slices. A tight
+// memory budget of one block per book raises the false-positive rate, so
+// the exact checks must weed out more candidates; a smaller one is
+// rejected.
+void check_signatures() {
+    Corpus corpus = make_corpus(120, 40, 11);
+    std::vector<std::string> absent = numbered_words("x", 2000);
+    std::vector<std::pair<std::string, SignatureOptions>> variants = {{"", {}}, {" TIGHT BUDGET", {0.01, 8192}}};
+    for (SearchMode mode : {SearchMode::Postings, SearchMode::Signatures}) {
+        for (const auto& [suffix, options] : variants) {
+            if (mode == SearchMode::Postings && !suffix.empty()) continue;
+            std::string label = std::string(mode == SearchMode::Postings ? "Musk POSTINGS" : "Musk SIGNATURES") + suffix;
+            MuskLibrary lib(corpus.titles, corpus.texts);
+            lib.set_search_mode(mode, options);
+            auto misses = [&]() {
+                for (const auto& word : absent) {
+                    if (!lib.search_keyword(word).empty() || !lib.search_any({word}).empty() ||
+                        !lib.search_all({word, corpus.vocabulary[0]}).empty()) {
+                        return false;
+                    }
+                }
+                return true;
+            };
+            report(label + " SEARCH", same_searches(lib, corpus) && misses());
+            Corpus kept = remove_most(lib, corpus);
+            report(label + " SEARCH AFTER COMPACT", same_searches(lib, kept) && misses());
+        }
+    }
+    MuskLibrary lib(corpus.titles, corpus.texts);
+    auto rejects = [&](const SignatureOptions& options) {
+        try {
+            lib.set_search_mode(SearchMode::Signatures, options);
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    report("Musk SIGNATURES BAD OPTIONS", rejects({0.0, 0}) && rejects({1.0, 0}) && rejects({0.01, 64}) && !rejects({0.5, 0}));
+    std::cout << "\n\n";
+}
+
+bool same_ranked(const std::vector<RankedBook>& a, const std::vector<RankedBook>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].title != b[i].title || a[i].score != b[i].score) return false;
+    }
+    return true;
+}
+
+// add_books on four threads against add_book one book at a time, on a batch
+// big enough to be worth the threads, with and without term frequencies.
+// The batch names one title twice, and the later text must win as it does
+// for add_book.
+void check_parallel_add() {
+    Corpus corpus = make_corpus(60, 2000, 9);
+    corpus.titles[40] = corpus.titles[7];
+    Corpus expected = corpus;
+    expected.titles.erase(expected.titles.begin() + 7);
+    expected.texts.erase(expected.texts.begin() + 7);
+    for (bool frequencies : {false, true}) {
+        std::string mode = frequencies ? " FREQUENCIES" : " PRESENCE";
+        MuskLibrary musk(expected.titles, expected.texts, 4, frequencies);
+        MuskLibrary serial_musk(expected.titles, expected.texts, 1, frequencies);
+        bool ok = same_searches(musk, expected);
+        for (size_t i = 0; i + 1 < expected.vocabulary.size(); ++i) {
+            std::vector<std::string> keywords = {expected.vocabulary[i], expected.vocabulary[i + 1]};
+            ok = ok && same_ranked(musk.search_ranked(keywords, 10), serial_musk.search_ranked(keywords, 10));
+        }
+        report("Musk PARALLEL ADD" + mode, ok);
+        for (const std::string name : {"Jobs", "Gates", "Bezos"}) {
+            JGBLibrary parallel(name, {10, 37, 7, 13}, HashFunction::Polynomial, 4, frequencies);
+            JGBLibrary serial(name, {10, 37, 7, 13}, HashFunction::Polynomial, 1, frequencies);
+            parallel.add_books(corpus.titles, corpus.texts);
+            for (size_t b = 0; b < corpus.titles.size(); ++b) {
+                serial.add_book(corpus.titles[b], corpus.texts[b]);
+            }
+            ok = same_searches(parallel, expected);
+            for (const auto& title : corpus.titles) {
+                ok = ok && parallel.distinct_words(title) == serial.distinct_words(title);
+            }
+            for (size_t i = 0; i + 1 < expected.vocabulary.size(); ++i) {
+                std::vector<std::string> keywords = {expected.vocabulary[i], expected.vocabulary[i + 1]};
+                ok = ok && same_ranked(parallel.search_ranked(keywords, 10), serial.search_ranked(keywords, 10));
+            }
+            report(name + " PARALLEL ADD" + mode, ok);
+        }
+    }
+    std::cout << "\n\n";
+}
+
+std::vector<std::string> tokens_of(std::string_view text) {
+    std::vector<std::string> tokens;
+    Tokenizer::for_each_token(text, [&](std::string_view token) { tokens.emplace_back(token); });
+    return tokens;
+}
+
+// Cuts one text into three pieces at every pair of positions and feeds them
+// to a Tokenizer::Stream, which must report the tokens for_each_token finds
+// in the whole text. The text has tokens longer than a 16-byte block, runs
+// of delimiters, control characters and UTF-8.
+void check_tokenizer() {
+    std::string text = "  alpha\tbeta\r\n\ngamma-delta " + std::string(40, 'x') + "\x01\x1f" + "na\xC3\xAFve  \x7f!" +
+                       std::string(17, ' ') + "end";
+    std::vector<std::string> expected = tokens_of(text);
+    bool ok = expected.size() == 7 && expected[3] == std::string(40, 'x') && expected.back() == "end";
+    for (size_t a = 0; a <= text.size() && ok; ++a) {
+        for (size_t b = a; b <= text.size() && ok; ++b) {
+            std::vector<std::string> tokens;
+            auto collect = [&](std::string_view token) { tokens.emplace_back(token); };
+            Tokenizer::Stream<decltype(collect)&> stream(collect);
+            stream.feed(std::string_view(text).substr(0, a));
+            stream.feed(std::string_view(text).substr(a, b - a));
+            stream.feed(std::string_view(text).substr(b));
+            stream.finish();
+            ok = tokens == expected;
+        }
+    }
+    report("TOKENIZER STREAM SPLITS", ok);
+
+    // Bytes up to ' ' split words. That takes in every byte std::isspace
+    // knows, as the whitespace the texts used to be split on, and nothing
+    // printable or above 0x7F.
+    ok = true;
+    for (int c = 0; c < 256; ++c) {
+        bool delimiter = Tokenizer::is_delimiter(static_cast<char>(c));
+        ok = ok && (std::isspace(c) ? delimiter : delimiter == (c <= ' '));
+    }
+    std::string spaced = " one\ttwo\n\vthree\f\rfour  five\xC3\xA9 six";
+    std::istringstream words(spaced);
+    std::vector<std::string> split;
+    for (std::string word; words >> word;) {
+        split.push_back(word);
+    }
+    report("TOKENIZER DELIMITERS", ok && tokens_of(spaced) == split);
+}
+
+// Writes a corpus as one file per book, with mixed whitespace, next to an
+// empty book and a subdirectory, and checks add_books_from_directory gives
+// the same library as add_books on the texts.
+void check_directory_ingest() {
+    Corpus corpus = make_corpus(12, 300, 17);
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "library_check_books";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory / "nested");
+    const char* gaps[] = {" ", "\n", "\t", "  ", "\r\n"};
+    for (size_t b = 0; b < corpus.titles.size(); ++b) {
+        std::ofstream file(directory / (corpus.titles[b] + ".txt"), std::ios::binary);
+        for (size_t w = 0; w < corpus.texts[b].size(); ++w) {
+            file << corpus.texts[b][w] << gaps[w % 5];
+        }
+    }
+    std::ofstream(directory / "empty.txt").close();
+    corpus.titles.push_back("empty");
+    corpus.texts.push_back({});
+
+    bool ok = true;
+    for (const std::string name : {"Jobs", "Gates", "Bezos"}) {
+        JGBLibrary from_files(name, {10, 37, 7, 13});
+        JGBLibrary from_texts(name, {10, 37, 7, 13});
+        from_files.add_books_from_directory(directory.string());
+        from_texts.add_books(corpus.titles, corpus.texts);
+        ok = ok && same_searches(from_files, corpus);
+        for (const auto& title : corpus.titles) {
+            ok = ok && from_files.distinct_words(title) == from_texts.distinct_words(title);
+        }
+        ok = ok && from_files.distinct_words("nested").empty();
+    }
+    std::filesystem::remove_all(directory);
+    report("DIRECTORY INGEST", ok);
+    std::cout << "\n\n";
+}
+
+bool same_prefix_matches(const std::vector<PrefixMatch>& a, const std::vector<PrefixMatch>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].word != b[i].word || a[i].books != b[i].books) return false;
+    }
+    return true;
+}
+
+// Whether lib answers every non-ranked query on the corpus like oracle.
+bool same_library(DigitalLibrary& lib, DigitalLibrary& oracle, const Corpus& corpus) {
+    std::vector<std::string> titles = corpus.titles;
+    titles.push_back("missing");
+    std::vector<std::string> words = corpus.vocabulary;
+    words.push_back("absent");
+    if (lib.book_titles() != oracle.book_titles() || lib.search_keywords(words) != oracle.search_keywords(words)) return false;
+    for (const auto& title : titles) {
+        if (lib.distinct_words(title) != oracle.distinct_words(title) ||
+            lib.count_distinct_words(title) != oracle.count_distinct_words(title)) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i + 1 < words.size(); ++i) {
+        std::vector<std::string> pair = {words[i], words[i + 1]};
+        if (lib.search_keyword(words[i]) != oracle.search_keyword(words[i]) || lib.search_all(pair) != oracle.search_all(pair) ||
+            lib.search_any(pair) != oracle.search_any(pair)) {
+            return false;
+        }
+    }
+    for (const std::string prefix : {"", "v", "v1", "v5", "x"}) {
+        for (size_t limit : {3, 100}) {
+            if (!same_prefix_matches(lib.search_prefix(prefix, limit), oracle.search_prefix(prefix, limit))) return false;
+        }
+    }
+    return true;
+}
+
+// Saves a library with a removed book, serves the file back, and checks a
+// byte flipped past the header fails a full check.
+void check_snapshot() {
+    Corpus corpus = make_corpus(40, 50, 11);
+    std::string path = (std::filesystem::temp_directory_path() / "library_check.snapshot").string();
+    MuskLibrary musk(corpus.titles, corpus.texts);
+    JGBLibrary jobs("Jobs", {10, 29});
+    jobs.add_books(corpus.titles, corpus.texts);
+    for (auto& [lib, name] : std::vector<std::pair<DigitalLibrary*, std::string>>{{&musk, "Musk"}, {&jobs, "Jobs"}}) {
+        lib->remove_book(corpus.titles[3]);
+        lib->save_snapshot(path);
+        std::unique_ptr<DigitalLibrary> loaded = load_snapshot(path, Snapshot::Check::Full);
+        report(name + " SNAPSHOT ROUND TRIP", same_library(*loaded, *lib, corpus));
+    }
+
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekg(0, std::ios::end);
+    std::streamoff end = file.tellg();
+    file.seekg(end - 1);
+    char last = static_cast<char>(file.get());
+    file.seekp(end - 1);
+    file.put(static_cast<char>(last ^ 0x5A));
+    file.close();
+    bool rejected = false;
+    try {
+        load_snapshot(path, Snapshot::Check::Full);
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    report("SNAPSHOT CHECKSUM", rejected);
+    std::filesystem::remove(path);
+    std::cout << "\n\n";
+}
+
+// One writer adds batches of books while readers query. Every book has the
+// word "shared", and titles sort in the order they are added, so each
+// answer must be the titles of the first few whole batches: never fewer
+// than a reader saw before, and never part of a batch.
+void check_concurrent() {
+    const size_t batches = 200;
+    const size_t batch_size = 5;
+    std::vector<std::string> titles;
+    for (size_t i = 0; i < batches * batch_size; ++i) {
+        std::string number = std::to_string(i);
+        titles.push_back("book" + std::string(4 - number.size(), '0') + number);
+    }
+    ConcurrentLibrary lib([]() { return std::make_unique<JGBLibrary>("Gates", std::vector<int>{10, 37}); });
+    std::atomic<bool> writing(true);
+    std::atomic<bool> ok(true);
+    std::atomic<int> started(0);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; ++r) {
+        readers.emplace_back([&]() {
+            started++;
+            size_t seen = 0;
+            bool last = false;
+            while (!last) {
+                last = !writing.load();
+                std::vector<std::string> found = lib.search_keyword("shared");
+                bool whole = found.size() >= seen && found.size() % batch_size == 0 &&
+                             std::equal(found.begin(), found.end(), titles.begin());
+                int words = found.empty() ? 0 : lib.count_distinct_words(found.back());
+                if (!whole || (!found.empty() && words != 2) || (last && found.size() != titles.size())) {
+                    ok = false;
+                }
+                seen = found.size();
+            }
+        });
+    }
+    while (started.load() < 3) {
+        std::this_thread::yield();
+    }
+    for (size_t b = 0; b < batches; ++b) {
+        std::vector<std::string> batch_titles(titles.begin() + b * batch_size, titles.begin() + (b + 1) * batch_size);
+        std::vector<std::vector<std::string>> texts(batch_size, {"shared", "batch" + std::to_string(b)});
+        lib.add_books(batch_titles, texts);
+    }
+    writing = false;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    report("CONCURRENT READERS", ok && lib.search_keyword("batch7").size() == batch_size);
+    std::cout << "\n\n";
+}
+
+// BM25 with k1 = 1.2 and b = 0.75, scored book by book. Without
+// frequencies every word a book contains counts once. Ties go by title.
+std::vector<RankedBook> brute_force_ranked(const std::vector<std::string>& titles, const std::vector<std::vector<std::string>>& texts,
+                                           std::vector<std::string> keywords, size_t k, bool frequencies) {
+    std::sort(keywords.begin(), keywords.end());
+    keywords.erase(std::unique(keywords.begin(), keywords.end()), keywords.end());
+    double average_length = 0;
+    for (const auto& text : texts) {
+        average_length += text.size();
+    }
+    average_length = std::max(1.0, average_length / texts.size());
+    std::vector<RankedBook> ranked;
+    for (size_t b = 0; b < texts.size(); ++b) {
+        double score = 0;
+        bool matched = false;
+        for (const auto& keyword : keywords) {
+            double f = std::count(texts[b].begin(), texts[b].end(), keyword);
+            if (f == 0) continue;
+            f = frequencies ? f : 1;
+            double containing = 0;
+            for (const auto& text : texts) {
+                containing += std::count(text.begin(), text.end(), keyword) > 0;
+            }
+            double idf = std::log(1 + (texts.size() - containing + 0.5) / (containing + 0.5));
+            score += idf * f * 2.2 / (f + 1.2 * (0.25 + 0.75 * texts[b].size() / average_length));
+            matched = true;
+        }
+        if (matched) ranked.push_back({titles[b], score});
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const RankedBook& a, const RankedBook& b) {
+        return a.score > b.score || (a.score == b.score && a.title < b.title);
+    });
+    if (ranked.size() > k) ranked.resize(k);
+    return ranked;
+}
+
+// search_ranked of lib against brute_force_ranked for every query of one
+// or two words of the texts, and a word in no book.
+bool same_ranking(DigitalLibrary& lib, const std::vector<std::string>& titles, const std::vector<std::vector<std::string>>& texts,
+                  bool frequencies) {
+    std::vector<std::string> words = {"absent"};
+    for (const auto& text : texts) {
+        words.insert(words.end(), text.begin(), text.end());
+    }
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    for (size_t i = 0; i < words.size(); ++i) {
+        for (size_t j = i; j < words.size(); ++j) {
+            for (size_t k : {1, 3, 100}) {
+                std::vector<std::string> keywords = {words[i], words[j]};
+                std::vector<RankedBook> expected = brute_force_ranked(titles, texts, keywords, k, frequencies);
+                std::vector<RankedBook> ranked = lib.search_ranked(keywords, k);
+                if (ranked.size() != expected.size()) return false;
+                for (size_t r = 0; r < ranked.size(); ++r) {
+                    if (ranked[r].title != expected[r].title || std::abs(ranked[r].score - expected[r].score) > 1e-9) return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Both libraries, with and without term frequencies. MuskLibrary numbers
+// books in title order, JGBLibrary in the order they were added; both must
+// break ties by title.
+void check_ranked(const std::vector<std::string>& titles, const std::vector<std::vector<std::string>>& texts,
+                  const std::string& name) {
+    for (bool frequencies : {false, true}) {
+        std::string mode = frequencies ? " FREQUENCIES" : " PRESENCE";
+        MuskLibrary musk(titles, texts, 1, frequencies);
+        report("Musk " + name + mode + " RANKED", same_ranking(musk, titles, texts, frequencies));
+        JGBLibrary jobs("Jobs", {10, 29}, HashFunction::Polynomial, 1, frequencies);
+        for (size_t i = 0; i < titles.size(); ++i) {
+            jobs.add_book(titles[i], texts[i]);
+        }
+        report("Jobs " + name + mode + " RANKED", same_ranking(jobs, titles, texts, frequencies));
+    }
+}
+
+// Feeds a sharded library and a single one the same adds and removes and
+// compares their answers. Ranked results are scored per shard, so only
+// their membership and order, best score first and ties by title, are
+// checked.
+void check_sharded(ShardMode mode, const std::string& name) {
+    Corpus corpus = make_corpus(50, 40, 23);
+    auto make = []() -> std::unique_ptr<DigitalLibrary> {
+        return std::make_unique<JGBLibrary>("Gates", std::vector<int>{10, 29}, HashFunction::Polynomial, 1, true);
+    };
+    ShardedLibrary sharded(3, make, mode);
+    std::unique_ptr<DigitalLibrary> oracle = make();
+    std::vector<std::string> first_titles(corpus.titles.begin(), corpus.titles.begin() + 30);
+    std::vector<std::vector<std::string>> first_texts(corpus.texts.begin(), corpus.texts.begin() + 30);
+    sharded.add_books(first_titles, first_texts);
+    oracle->add_books(first_titles, first_texts);
+    for (size_t i = 30; i < corpus.titles.size(); ++i) {
+        sharded.add_book(corpus.titles[i], corpus.texts[i]);
+        oracle->add_book(corpus.titles[i], corpus.texts[i]);
+    }
+    for (size_t i : {4, 17, 42}) {
+        sharded.remove_book(corpus.titles[i]);
+        oracle->remove_book(corpus.titles[i]);
+    }
+    report(name + " SHARDED QUERIES", same_library(sharded, *oracle, corpus));
+
+    bool ordered = true;
+    for (size_t i = 0; i + 1 < corpus.vocabulary.size(); ++i) {
+        std::vector<std::string> keywords = {corpus.vocabulary[i], corpus.vocabulary[i + 1]};
+        std::vector<RankedBook> ranked = sharded.search_ranked(keywords, 10);
+        std::vector<std::string> any = oracle->search_any(keywords);
+        ordered = ordered && ranked.size() == std::min<size_t>(10, any.size());
+        for (size_t r = 0; r < ranked.size() && ordered; ++r) {
+            ordered = std::binary_search(any.begin(), any.end(), ranked[r].title);
+            if (r > 0) {
+                const RankedBook& prev = ranked[r - 1];
+                ordered = ordered && (prev.score > ranked[r].score || (prev.score == ranked[r].score && prev.title < ranked[r].title));
+            }
+        }
+    }
+    report(name + " SHARDED RANKED ORDER", ordered);
+}
+
+// Worker processes fork, so they may only start while no other thread
+// runs: not beside a live pool, nor beside a plain thread.
+void check_fork_guard() {
+    auto make = []() -> std::unique_ptr<DigitalLibrary> { return std::make_unique<JGBLibrary>("Gates", std::vector<int>{10, 29}); };
+    auto refused = [&]() {
+        try {
+            ShardedLibrary sharded(2, make, ShardMode::Processes);
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    bool ok = !refused();
+    {
+        ThreadPool pool(2);
+        ok = ok && ThreadPool::live_threads() == 2 && refused();
+    }
+    std::atomic<bool> release(false);
+    std::thread other([&]() {
+        while (!release) std::this_thread::yield();
+    });
+    ok = ok && ThreadPool::live_threads() == 0 && refused();
+    release = true;
+    other.join();
+    report("FORK GUARD", ok && !refused());
+}
+
+// A repeated query must hit the cache, and every add or remove must bump
+// the version so that the next query sees the change, not the cached result.
+// A budget too small for the whole vocabulary must evict without changing
+// any answer.
+void check_cache(const std::vector<std::string>& titles, const std::vector<std::vector<std::string>>& texts) {
+    CachedLibrary lib(std::make_unique<JGBLibrary>("Gates", std::vector<int>{10, 29}), 1 << 16);
+    lib.add_books(titles, texts);
+    uint64_t version = lib.get_version();
+    std::vector<std::string> books = lib.search_keyword("book");
+    std::vector<std::string> words = lib.distinct_words("book1");
+    bool ok = lib.search_keyword("book") == books && lib.distinct_words("book1") == words && lib.cache_stats().hits == 2;
+
+    lib.add_book("book3", {"another", "book"});
+    ok = ok && lib.get_version() > version && lib.search_keyword("book") == std::vector<std::string>{"book1", "book2", "book3"};
+    version = lib.get_version();
+
+    lib.remove_book("book1");
+    ok = ok && lib.get_version() > version && lib.search_keyword("book") == std::vector<std::string>{"book2", "book3"} &&
+         lib.distinct_words("book1").empty();
+    version = lib.get_version();
+
+    lib.add_book("book1", {"a", "new", "text"});
+    ok = ok && lib.get_version() > version && lib.distinct_words("book1") == std::vector<std::string>{"a", "new", "text"} &&
+         lib.search_keyword("book") == std::vector<std::string>{"book2", "book3"};
+    report("CACHE INVALIDATION", ok);
+
+    Corpus corpus = make_corpus(40, 40, 29);
+    CachedLibrary small(std::make_unique<JGBLibrary>("Gates", std::vector<int>{10, 29}), 2048);
+    small.add_books(corpus.titles, corpus.texts);
+    bool same = same_searches(small, corpus);
+    std::vector<std::string> hot = small.search_keyword(corpus.vocabulary[0]);
+    same = same && small.search_keyword(corpus.vocabulary[0]) == hot;
+    ResultCache::Stats stats = small.cache_stats();
+    report("CACHE EVICTION", same && stats.evictions > 0 && stats.hits > 0 && stats.bytes <= 2048);
+
+    // Views come from the cached result itself, hit or miss, and a result
+    // handed out stays intact after the cache evicts it.
+    JGBLibrary plain("Gates", std::vector<int>{10, 29});
+    plain.add_books(corpus.titles, corpus.texts);
+    uint64_t hits = small.cache_stats().hits;
+    bool views = true;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (const auto& word : corpus.vocabulary) {
+            std::vector<std::string_view> titles = small.search_keyword_views(word);
+            views = views && std::vector<std::string>(titles.begin(), titles.end()) == plain.search_keyword(word);
+        }
+        for (const auto& title : corpus.titles) {
+            std::vector<std::string_view> words = small.distinct_word_views(title);
+            views = views && std::vector<std::string>(words.begin(), words.end()) == plain.distinct_words(title);
+        }
+    }
+    ResultCache direct(1024);
+    auto kept = std::make_shared<const ResultCache::Result>(ResultCache::Result{"kept", "result"});
+    direct.put("key", 0, kept);
+    bool shared = direct.find("key", 0) == kept;
+    for (int i = 0; i < 64; ++i) {
+        direct.put(std::to_string(i), 0, std::make_shared<const ResultCache::Result>(ResultCache::Result{"filler"}));
+    }
+    shared = shared && direct.find("key", 0) == nullptr && *kept == ResultCache::Result{"kept", "result"};
+    report("CACHE VIEWS", views && small.cache_stats().hits > hits && shared);
+    std::cout << "\n\n";
+}
+
+// Whether Benchmark::parse_options rejects the command line args.
+bool rejects(std::vector<const char*> args) {
+    args.insert(args.begin(), "benchmark");
+    try {
+        Benchmark::parse_options(static_cast<int>(args.size()), const_cast<char**>(args.data()));
+    } catch (const std::invalid_argument&) {
+        return true;
+    }
+    return false;
+}
+
+// The benchmark on a tiny corpus, in both output formats: every suite must
+// report its rows, each with a count and a latency only where measured, and
+// bad command lines must be rejected.
+void check_benchmark() {
+    std::vector<const char*> args = {"benchmark", "--books", "4", "--length", "60", "--vocab", "50", "--queries", "20",
+                                     "--threads", "2", "--format", "csv"};
+    Benchmark::Options options = Benchmark::parse_options(static_cast<int>(args.size()), const_cast<char**>(args.data()));
+    Benchmark benchmark(options);
+    std::vector<Benchmark::Row> rows = benchmark.run();
+    std::set<std::string> suites;
+    bool ok = options.books == 4 && options.queries == 20 && options.format == "csv";
+    for (const auto& row : rows) {
+        suites.insert(row.suite);
+        bool queried = row.op == "distinct_words" || row.op == "count_distinct_words" || row.op == "search_keyword";
+        ok = ok && row.count > 0 && row.total_s >= 0 && row.has_latency == queried && row.p50_ns <= row.p999_ns;
+    }
+    ok = ok && suites == std::set<std::string>{"FrozenSet", "HashMap", "HashSet", "library"};
+
+    std::ostringstream csv;
+    benchmark.print(rows, csv);
+    std::string text = csv.str();
+    ok = ok && std::count(text.begin(), text.end(), '\n') == static_cast<long>(rows.size()) + 1;
+    options.format = "json";
+    std::ostringstream json;
+    Benchmark(options).print(rows, json);
+    text = json.str();
+    size_t entries = 0;
+    for (size_t at = text.find("\"suite\""); at != std::string::npos; at = text.find("\"suite\"", at + 1)) {
+        entries++;
+    }
+    ok = ok && text.front() == '{' && entries == rows.size();
+    report("BENCHMARK SMOKE RUN", ok);
+    report("BENCHMARK BAD OPTIONS", rejects({"--help"}) && rejects({"--books", "0"}) && rejects({"--format", "xml"}) &&
+                                       rejects({"--bogus", "1"}) && !rejects({"--seed", "7"}));
+    std::cout << "\n\n";
+}
+
 int main() {
     std::vector<std::string> book_titles = {"book1", "book2"};
     std::vector<std::vector<std::string>> texts = {
@@ -55,8 +1335,6 @@ int main() {
         }
     }
 
-    PrimeGenerator::set_primes(get_primes());
-
     // Check Musk
     auto start = std::chrono::high_resolution_clock::now();
     MuskLibrary musk_lib(book_titles, texts);
@@ -83,5 +1361,71 @@ int main() {
         check_lib(lib, unique_words, word_to_books);
     }
 
+    std::cout << "Checking keyword search:" << std::endl;
+    check_searches();
+    check_signatures();
+    check_parallel_add();
+
+    std::cout << "Checking ranked search:" << std::endl;
+    check_ranked(book_titles, texts, "FIXTURE");
+    Corpus repeats = make_corpus(8, 30, 5);
+    check_ranked(repeats.titles, repeats.texts, "REPEATS");
+    // Identical books added against title order: every score ties, so the
+    // top k must be the first titles.
+    std::vector<std::string> tied_titles = {"tie4", "tie3", "tie2", "tie1", "tie0"};
+    check_ranked(tied_titles, std::vector<std::vector<std::string>>(tied_titles.size(), {"same", "words", "here"}), "TIES");
+    std::cout << "\n\n";
+
+    std::cout << "Checking hash tables:" << std::endl;
+    check_rehash_modes();
+    check_erase();
+    for (const auto& type : COLLISION_TYPES) {
+        check_churn(type);
+        check_max_loads(type);
+    }
+    std::cout << "\n\n";
+    check_growth();
+    bool bad_params = true;
+    for (const std::vector<int>& params : {std::vector<int>{10, 13}, std::vector<int>{10, 37, 0, 13}}) {
+        try {
+            DynamicHashSet set("Double", params);
+            bad_params = false;
+        } catch (const std::invalid_argument&) {
+        }
+    }
+    report("Double BAD PARAMS", bad_params);
+    check_freeze();
+    check_fast_hash();
+    check_stats();
+    check_find_batch();
+
+    std::cout << "Checking strings:" << std::endl;
+    check_string_pool();
+    check_string_sort();
+    check_views();
+    std::cout << "\n\n";
+
+    std::cout << "Checking file ingestion:" << std::endl;
+    check_tokenizer();
+    check_directory_ingest();
+
+    std::cout << "Checking snapshots:" << std::endl;
+    check_snapshot();
+
+    std::cout << "Checking concurrent reads:" << std::endl;
+    check_concurrent();
+
+    std::cout << "Checking sharded libraries:" << std::endl;
+    check_sharded(ShardMode::Threads, "THREADS");
+    check_sharded(ShardMode::Processes, "PROCESSES");
+    check_fork_guard();
+    std::cout << "\n\n";
+
+    std::cout << "Checking the result cache:" << std::endl;
+    check_cache(book_titles, texts);
+
+    std::cout << "Checking the benchmark:" << std::endl;
+    check_benchmark();
+
     return 0;
 }
\ No newline at end of file
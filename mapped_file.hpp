@@ -0,0 +1,162 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdexcept>
+#include <cstddef>
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPED_FILE_MMAP 1
+#else
+#include <fstream>
+#endif
+
+// Read-only file visited one WINDOW at a time. On POSIX systems each window
+// is memory-mapped and unmapped once visited, so only one window of a large
+// book is ever resident; elsewhere windows are read into a reused buffer.
+class MappedFile {
+public:
+    // A multiple of every common page size, as mmap offsets must be.
+    static constexpr size_t WINDOW = size_t(64) << 20;
+
+    explicit MappedFile(const std::string& path_) : path(path_) {
+#if defined(MAPPED_FILE_MMAP)
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::invalid_argument("Cannot open " + path);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::invalid_argument("Cannot stat " + path);
+        }
+        length = static_cast<size_t>(info.st_size);
+#else
+        in.open(path, std::ios::binary | std::ios::ate);
+        if (!in) {
+            throw std::invalid_argument("Cannot open " + path);
+        }
+        length = static_cast<size_t>(in.tellg());
+        in.seekg(0);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#if defined(MAPPED_FILE_MMAP)
+        ::close(fd);
+#endif
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    // Calls f(std::string_view) on consecutive windows covering the file.
+    // A window is only valid during its call.
+    template <typename F>
+    void for_each_window(F&& f) {
+        for (size_t offset = 0; offset < length; offset += WINDOW) {
+            size_t bytes = std::min(WINDOW, length - offset);
+#if defined(MAPPED_FILE_MMAP)
+            void* data = ::mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(offset));
+            if (data == MAP_FAILED) {
+                throw std::invalid_argument("Cannot map " + path);
+            }
+            ::madvise(data, bytes, MADV_SEQUENTIAL);
+            struct Unmap {
+                void* data;
+                size_t bytes;
+                ~Unmap() { ::munmap(data, bytes); }
+            } unmap{data, bytes};
+            f(std::string_view(static_cast<const char*>(data), bytes));
+#else
+            buffer.resize(bytes);
+            if (!in.read(buffer.data(), static_cast<std::streamsize>(bytes))) {
+                throw std::invalid_argument("Cannot read " + path);
+            }
+            f(std::string_view(buffer.data(), bytes));
+#endif
+        }
+    }
+
+private:
+    std::string path;
+    size_t length = 0;
+#if defined(MAPPED_FILE_MMAP)
+    int fd = -1;
+#else
+    std::ifstream in;
+    std::vector<char> buffer;
+#endif
+};
+
+// Whole file mapped read-only and shared, so every process mapping the same
+// file reads one page-cache copy. Without mmap the file is read into memory.
+class MappedView {
+public:
+    explicit MappedView(const std::string& path) {
+        MappedFile file(path);
+        length = file.size();
+#if defined(MAPPED_FILE_MMAP)
+        if (length == 0) return;
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::invalid_argument("Cannot open " + path);
+        }
+        void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            throw std::invalid_argument("Cannot map " + path);
+        }
+        bytes = static_cast<const char*>(mapped);
+#else
+        // uint64_t storage keeps the data 8-byte aligned like a mapping.
+        buffer.resize((length + 7) / 8);
+        size_t offset = 0;
+        file.for_each_window([&](std::string_view window) {
+            std::copy(window.begin(), window.end(), reinterpret_cast<char*>(buffer.data()) + offset);
+            offset += window.size();
+        });
+        bytes = reinterpret_cast<const char*>(buffer.data());
+#endif
+    }
+
+    MappedView(const MappedView&) = delete;
+    MappedView& operator=(const MappedView&) = delete;
+
+    ~MappedView() {
+#if defined(MAPPED_FILE_MMAP)
+        if (bytes != nullptr) {
+            ::munmap(const_cast<char*>(bytes), length);
+        }
+#endif
+    }
+
+    const char* data() const {
+        return bytes;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+#if !defined(MAPPED_FILE_MMAP)
+    std::vector<uint64_t> buffer;
+#endif
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef PREFETCH_HPP
+#define PREFETCH_HPP
+
+#if defined(__SSE2__)
+#include <xmmintrin.h>
+#endif
+
+// Asks for the cache line holding p ahead of its first read. Batched lookups
+// issue these for many keys before touching any, so the misses overlap.
+// Does nothing on targets without SSE.
+inline void prefetch(const void* p) {
+#if defined(__SSE2__)
+    _mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#else
+    (void)p;
+#endif
+}
+
+#endif
\ No newline at end of file
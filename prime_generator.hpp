@@ -2,26 +2,45 @@
 #define PRIME_GENERATOR_HPP
 
 #include <vector>
+#include <stdexcept>
 
 namespace PrimeGenerator
 {
     static std::vector<int> prime_sizes = {29};
 
+    // Each prime is roughly double the one before, so a table walking this
+    // list grows geometrically without sieving anything at startup.
+    constexpr int GROWTH_PRIMES[] = {
+        3, 7, 13, 29, 53, 97, 193, 389, 769, 1543, 3079, 6151, 12289, 24593, 49157, 98317, 196613, 393241,
+        786433, 1572869, 3145739, 6291469, 12582917, 25165843, 50331653, 100663319, 201326611, 402653189,
+        805306457, 1610612741};
+
     void set_primes(const std::vector<int> &primes)
     {
         prime_sizes = primes;
     }
 
+    // Pops the next size of the list shared by every Growth::Shared table.
     int get_next_size()
     {
         if (prime_sizes.empty())
         {
-            4294967291;
+            throw std::invalid_argument("No prime sizes left");
         }
         int size = prime_sizes.back();
         prime_sizes.pop_back();
         return size;
     }
+
+    // Smallest growth prime above size.
+    inline int next_prime_after(int size)
+    {
+        for (int prime : GROWTH_PRIMES)
+        {
+            if (prime > size) return prime;
+        }
+        throw std::invalid_argument("No prime sizes left");
+    }
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,157 @@
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+#include "fast_hash.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// Bounded cache of query results, each stored with the library version it
+// was computed at. A lookup at any other version misses, so bumping the
+// version invalidates everything at once without touching the entries.
+// Eviction is CLOCK: a hit sets the entry's reference bit, and the hand
+// clears set bits and evicts the first entry found clear (or stale). Results
+// are shared, so a hit hands out the cached vector without copying it and a
+// caller may keep it after it is evicted. Sizes are approximate: keys,
+// strings and per-entry overhead, not allocator slack.
+class ResultCache {
+public:
+    using Result = std::vector<std::string>;
+    using Shared = std::shared_ptr<const Result>;
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t entries;
+        size_t bytes;
+    };
+
+    explicit ResultCache(size_t budget_) : budget(budget_), used(0), hand(0), hits(0), misses(0), evictions(0) {}
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // The result cached for key at version, or nullptr.
+    Shared find(std::string_view key, uint64_t version) {
+        auto it = index.find(key);
+        if (it == index.end() || entries[it->second].version != version) {
+            misses++;
+            return nullptr;
+        }
+        Entry& entry = entries[it->second];
+        entry.referenced = true;
+        hits++;
+        return entry.result;
+    }
+
+    // Caches result for key at version, evicting as needed. Results larger
+    // than the whole budget are not cached.
+    void put(std::string_view key, uint64_t version, Shared result) {
+        size_t bytes = size_of(key, *result);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            release(it->second);
+        }
+        if (bytes > budget) return;
+        while (used + bytes > budget) {
+            evict_one(version);
+        }
+        size_t slot;
+        if (free.empty()) {
+            slot = entries.size();
+            entries.emplace_back();
+        } else {
+            slot = free.back();
+            free.pop_back();
+        }
+        Entry& entry = entries[slot];
+        entry.key.assign(key);
+        entry.result = std::move(result);
+        entry.version = version;
+        entry.bytes = bytes;
+        entry.live = true;
+        entry.referenced = false;
+        index.emplace(entry.key, slot);
+        used += bytes;
+    }
+
+    void clear() {
+        index.clear();
+        entries.clear();
+        free.clear();
+        used = 0;
+        hand = 0;
+    }
+
+    Stats stats() const {
+        return {hits, misses, evictions, index.size(), used};
+    }
+
+    size_t get_budget() const {
+        return budget;
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        Shared result;
+        uint64_t version = 0;
+        size_t bytes = 0;
+        bool live = false;
+        bool referenced = false;
+    };
+
+    size_t budget;
+    size_t used;
+    size_t hand;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    // A deque so that growing it never moves the keys index points into.
+    std::deque<Entry> entries;
+    std::vector<size_t> free;
+    std::unordered_map<std::string_view, size_t, FastHash::Hasher> index;
+
+    static size_t size_of(std::string_view key, const Result& result) {
+        size_t bytes = sizeof(Entry) + key.size() + result.size() * sizeof(std::string);
+        for (const auto& s : result) {
+            bytes += s.size();
+        }
+        return bytes;
+    }
+
+    void release(size_t slot) {
+        Entry& entry = entries[slot];
+        index.erase(entry.key);
+        used -= entry.bytes;
+        entry.live = false;
+        std::string().swap(entry.key);
+        entry.result.reset();
+        free.push_back(slot);
+    }
+
+    // Entries from another version go first. Only called while something is
+    // cached, so the hand finds a victim within two turns.
+    void evict_one(uint64_t version) {
+        while (true) {
+            if (hand >= entries.size()) hand = 0;
+            Entry& entry = entries[hand++];
+            if (!entry.live) continue;
+            if (entry.referenced && entry.version == version) {
+                entry.referenced = false;
+                continue;
+            }
+            release(hand - 1);
+            evictions++;
+            return;
+        }
+    }
+};
+
+#endif
\ No newline at end of file
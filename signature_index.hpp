@@ -0,0 +1,144 @@
+#ifndef SIGNATURE_INDEX_HPP
+#define SIGNATURE_INDEX_HPP
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "fast_hash.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// A blocked Bloom filter per book, stored bit-sliced: slice p holds bit p of
+// every book's filter, one bit per book. A word sets its k bits inside one
+// 512-bit block of the filter, so a query ANDs k slices from the same
+// block's run of slices and gets every book that may hold the word at once.
+class SignatureIndex {
+public:
+    static constexpr int BLOCK_BITS = 512;
+    static constexpr int MAX_HASHES = 16;
+
+    SignatureIndex() = default;
+
+    // Sized so a book of max_words distinct words answers false positives at
+    // about false_positive_rate. A nonzero memory_budget (bytes) caps the
+    // slices; a tighter budget gives a higher rate.
+    SignatureIndex(size_t books_, size_t max_words, double false_positive_rate, size_t memory_budget) : books(books_) {
+        if (!(false_positive_rate > 0 && false_positive_rate < 1)) {
+            throw std::invalid_argument("False positive rate must be between 0 and 1");
+        }
+        stride = (books + 63) / 64;
+        double words = static_cast<double>(std::max<size_t>(max_words, 1));
+        double ln2 = std::log(2.0);
+        size_t bits = static_cast<size_t>(std::ceil(-words * std::log(false_positive_rate) / (ln2 * ln2)));
+        size_t block_count = std::max<size_t>(1, (bits + BLOCK_BITS - 1) / BLOCK_BITS);
+        if (memory_budget > 0 && stride > 0) {
+            size_t affordable = memory_budget / (stride * sizeof(uint64_t) * BLOCK_BITS);
+            if (affordable == 0) {
+                throw std::invalid_argument("Memory budget too small for one block per book");
+            }
+            block_count = std::min(block_count, affordable);
+        }
+        blocks = static_cast<uint32_t>(block_count);
+        double per_word = static_cast<double>(block_count * BLOCK_BITS) / words;
+        hashes = std::clamp(static_cast<int>(std::lround(per_word * ln2)), 1, MAX_HASHES);
+        slices.assign(block_count * BLOCK_BITS * stride, 0);
+    }
+
+    void add(size_t book, std::string_view word) {
+        for_each_bit(word, [&](size_t bit) { slices[bit * stride + book / 64] |= uint64_t(1) << (book % 64); });
+    }
+
+    // Sets result to the books whose filters hold every word, as one bit per
+    // book in words_per_slice() 64-bit words. No words gives every book.
+    void candidates(const std::vector<std::string>& words, std::vector<uint64_t>& result) const {
+        result.assign(stride, ~uint64_t(0));
+        if (books % 64 != 0 && stride > 0) {
+            result.back() = (uint64_t(1) << (books % 64)) - 1;
+        }
+        for (const auto& word : words) {
+            for_each_bit(word, [&](size_t bit) { and_into(result.data(), slices.data() + bit * stride, stride); });
+        }
+    }
+
+    // Calls f(book) for every book set in a candidates() result, in order.
+    template <typename F>
+    static void for_each_book(const std::vector<uint64_t>& bits, F&& f) {
+        for (size_t w = 0; w < bits.size(); ++w) {
+            for (uint64_t word = bits[w]; word != 0; word &= word - 1) {
+                f(w * 64 + lowest(word));
+            }
+        }
+    }
+
+    size_t words_per_slice() const {
+        return stride;
+    }
+
+    int filter_bits() const {
+        return static_cast<int>(blocks) * BLOCK_BITS;
+    }
+
+    int hash_count() const {
+        return hashes;
+    }
+
+    size_t memory_bytes() const {
+        return slices.capacity() * sizeof(uint64_t);
+    }
+
+private:
+    size_t books = 0;
+    size_t stride = 0;
+    uint32_t blocks = 0;
+    int hashes = 0;
+    std::vector<uint64_t> slices;
+
+    // The high half of the hash picks the block; the low half and a second
+    // mix give the start and odd stride of k distinct bits inside it.
+    template <typename F>
+    void for_each_bit(std::string_view word, F&& f) const {
+        uint64_t hash = FastHash::hash(word);
+        size_t base = static_cast<size_t>(((hash >> 32) * blocks) >> 32) * BLOCK_BITS;
+        uint32_t bit = static_cast<uint32_t>(hash);
+        uint32_t step = static_cast<uint32_t>(FastHash::mix(hash, FastHash::SECRET1)) | 1;
+        for (int i = 0; i < hashes; ++i, bit += step) {
+            f(base + (bit & (BLOCK_BITS - 1)));
+        }
+    }
+
+    static size_t lowest(uint64_t word) {
+#if defined(__GNUC__)
+        return static_cast<size_t>(__builtin_ctzll(word));
+#else
+        size_t i = 0;
+        while (!(word & 1)) {
+            word >>= 1;
+            ++i;
+        }
+        return i;
+#endif
+    }
+
+    static void and_into(uint64_t* dst, const uint64_t* src, size_t n) {
+        size_t i = 0;
+#if defined(__SSE2__)
+        for (; i + 2 <= n; i += 2) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_and_si128(a, b));
+        }
+#endif
+        for (; i < n; ++i) {
+            dst[i] &= src[i];
+        }
+    }
+};
+
+#endif
\ No newline at end of file
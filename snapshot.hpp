@@ -0,0 +1,350 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <stdexcept>
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include "fast_hash.hpp"
+#include "mapped_file.hpp"
+
+// On-disk library snapshot, read in place through a shared mapping.
+//
+//   Header
+//   title offsets     uint64[books + 1]   into title chars
+//   title chars       titles in sorted order, not terminated
+//   word offsets      uint64[words + 1]   into word chars
+//   word chars        the dictionary in sorted order
+//   book offsets      uint64[books + 1]   into book words
+//   book words        uint32 word IDs of each book, ascending
+//   posting offsets   uint64[words + 1]   into postings
+//   postings          uint32 book IDs of each word, ascending
+//
+// Book IDs and word IDs are positions in the sorted tables, so ascending
+// IDs are also alphabetical. Every section starts 8-byte aligned. checksum
+// is FastHash::hash of everything after the header; header_checksum covers
+// the header itself, hashed with that field zeroed.
+namespace Snapshot
+{
+    constexpr char MAGIC[8] = {'D', 'L', 'S', 'N', 'A', 'P', '\0', '\0'};
+    constexpr uint32_t VERSION = 1;
+    // Reads back as a different value on a machine of the other byte order.
+    constexpr uint32_t ENDIAN_TAG = 0x01020304;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t endian_tag;
+        uint64_t file_size;
+        uint64_t checksum;
+        uint32_t book_count;
+        uint32_t word_count;
+        uint64_t title_offsets;
+        uint64_t title_chars;
+        uint64_t word_offsets;
+        uint64_t word_chars;
+        uint64_t book_offsets;
+        uint64_t book_words;
+        uint64_t posting_offsets;
+        uint64_t postings;
+        uint64_t header_checksum;
+    };
+
+    inline uint64_t header_hash(Header header)
+    {
+        header.header_checksum = 0;
+        return FastHash::hash(reinterpret_cast<const char*>(&header), sizeof(Header));
+    }
+
+    struct IdRange
+    {
+        const uint32_t* first;
+        const uint32_t* last;
+
+        const uint32_t* begin() const { return first; }
+        const uint32_t* end() const { return last; }
+        size_t size() const { return static_cast<size_t>(last - first); }
+    };
+
+    inline void pad(std::vector<char>& out)
+    {
+        out.resize((out.size() + 7) / 8 * 8, '\0');
+    }
+
+    template <typename T>
+    void append(std::vector<char>& out, const T* items, size_t count)
+    {
+        size_t at = out.size();
+        out.resize(at + count * sizeof(T));
+        if (count > 0) std::memcpy(out.data() + at, items, count * sizeof(T));
+    }
+
+    // Appends an offset table and the concatenated strings; returns the
+    // file offsets of both.
+    inline std::pair<uint64_t, uint64_t> append_strings(std::vector<char>& out, const std::vector<std::string>& strings)
+    {
+        std::vector<uint64_t> offsets(strings.size() + 1, 0);
+        for (size_t i = 0; i < strings.size(); ++i)
+        {
+            offsets[i + 1] = offsets[i] + strings[i].size();
+        }
+        uint64_t offsets_at = out.size();
+        append(out, offsets.data(), offsets.size());
+        uint64_t chars_at = out.size();
+        for (const auto& s : strings)
+        {
+            append(out, s.data(), s.size());
+        }
+        pad(out);
+        return {offsets_at, chars_at};
+    }
+
+    // Writes a snapshot of books given as sorted titles and, per title, its
+    // sorted distinct words. The file is written next to path and renamed
+    // over it, so readers still mapping an older snapshot are unaffected.
+    inline void write(const std::string& path, const std::vector<std::string>& titles,
+                      const std::vector<std::vector<std::string>>& book_words)
+    {
+        std::vector<std::string> dictionary;
+        for (const auto& words : book_words)
+        {
+            dictionary.insert(dictionary.end(), words.begin(), words.end());
+        }
+        std::sort(dictionary.begin(), dictionary.end());
+        dictionary.erase(std::unique(dictionary.begin(), dictionary.end()), dictionary.end());
+
+        std::vector<uint64_t> book_offsets(titles.size() + 1, 0);
+        std::vector<uint32_t> word_ids;
+        std::vector<uint64_t> posting_offsets(dictionary.size() + 1, 0);
+        for (size_t b = 0; b < titles.size(); ++b)
+        {
+            for (const auto& word : book_words[b])
+            {
+                uint32_t id = static_cast<uint32_t>(std::lower_bound(dictionary.begin(), dictionary.end(), word) - dictionary.begin());
+                word_ids.push_back(id);
+                posting_offsets[id + 1]++;
+            }
+            book_offsets[b + 1] = word_ids.size();
+        }
+        for (size_t w = 0; w < dictionary.size(); ++w)
+        {
+            posting_offsets[w + 1] += posting_offsets[w];
+        }
+        std::vector<uint32_t> postings(word_ids.size());
+        std::vector<uint64_t> next(posting_offsets.begin(), posting_offsets.end() - 1);
+        for (size_t b = 0; b < titles.size(); ++b)
+        {
+            for (uint64_t i = book_offsets[b]; i < book_offsets[b + 1]; ++i)
+            {
+                postings[next[word_ids[i]]++] = static_cast<uint32_t>(b);
+            }
+        }
+
+        Header header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.endian_tag = ENDIAN_TAG;
+        header.book_count = static_cast<uint32_t>(titles.size());
+        header.word_count = static_cast<uint32_t>(dictionary.size());
+
+        std::vector<char> out(sizeof(Header));
+        pad(out);
+        std::tie(header.title_offsets, header.title_chars) = append_strings(out, titles);
+        std::tie(header.word_offsets, header.word_chars) = append_strings(out, dictionary);
+        header.book_offsets = out.size();
+        append(out, book_offsets.data(), book_offsets.size());
+        header.book_words = out.size();
+        append(out, word_ids.data(), word_ids.size());
+        pad(out);
+        header.posting_offsets = out.size();
+        append(out, posting_offsets.data(), posting_offsets.size());
+        header.postings = out.size();
+        append(out, postings.data(), postings.size());
+        pad(out);
+
+        header.file_size = out.size();
+        header.checksum = FastHash::hash(out.data() + sizeof(Header), out.size() - sizeof(Header));
+        header.header_checksum = header_hash(header);
+        std::memcpy(out.data(), &header, sizeof(Header));
+
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file.write(out.data(), static_cast<std::streamsize>(out.size())))
+            {
+                throw std::invalid_argument("Cannot write " + temporary);
+            }
+        }
+        std::filesystem::rename(temporary, path);
+    }
+
+    // Header: validate the header and that every section lies inside the
+    // file, which takes constant time but trusts the section contents.
+    // Full: also verify the checksum; use it for files from elsewhere.
+    enum class Check
+    {
+        Header,
+        Full
+    };
+
+    // Read-only view of a snapshot file. Nothing is decoded up front: every
+    // accessor reads the mapping directly.
+    class Reader
+    {
+    private:
+        MappedView file;
+        Header header;
+
+        template <typename T>
+        const T* at(uint64_t offset) const
+        {
+            return reinterpret_cast<const T*>(file.data() + offset);
+        }
+
+        void require(bool condition) const
+        {
+            if (!condition)
+            {
+                throw std::invalid_argument("Corrupt snapshot");
+            }
+        }
+
+        // The section of `count` items of T at offset fits in the file.
+        bool fits(uint64_t offset, uint64_t count, size_t item) const
+        {
+            return offset % 8 == 0 && offset <= file.size() && count <= (file.size() - offset) / item;
+        }
+
+        void validate(Check check) const
+        {
+            require(file.size() >= sizeof(Header));
+            require(std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0);
+            if (header.version != VERSION)
+            {
+                throw std::invalid_argument("Unsupported snapshot version " + std::to_string(header.version));
+            }
+            require(header.endian_tag == ENDIAN_TAG);
+            require(header.header_checksum == header_hash(header));
+            require(header.file_size == file.size());
+            uint64_t books = header.book_count;
+            uint64_t words = header.word_count;
+            require(fits(header.title_offsets, books + 1, sizeof(uint64_t)));
+            require(fits(header.word_offsets, words + 1, sizeof(uint64_t)));
+            require(fits(header.book_offsets, books + 1, sizeof(uint64_t)));
+            require(fits(header.posting_offsets, words + 1, sizeof(uint64_t)));
+            require(header.title_chars <= file.size() && at<uint64_t>(header.title_offsets)[books] <= file.size() - header.title_chars);
+            require(header.word_chars <= file.size() && at<uint64_t>(header.word_offsets)[words] <= file.size() - header.word_chars);
+            require(fits(header.book_words, at<uint64_t>(header.book_offsets)[books], sizeof(uint32_t)));
+            require(fits(header.postings, at<uint64_t>(header.posting_offsets)[words], sizeof(uint32_t)));
+            if (check == Check::Full)
+            {
+                uint64_t checksum = FastHash::hash(file.data() + sizeof(Header), file.size() - sizeof(Header));
+                require(checksum == header.checksum);
+            }
+        }
+
+        std::string_view string_at(uint64_t offsets, uint64_t chars, uint32_t i) const
+        {
+            const uint64_t* table = at<uint64_t>(offsets);
+            return std::string_view(file.data() + chars + table[i], table[i + 1] - table[i]);
+        }
+
+        IdRange range_at(uint64_t offsets, uint64_t ids, uint32_t i) const
+        {
+            const uint64_t* table = at<uint64_t>(offsets);
+            return {at<uint32_t>(ids) + table[i], at<uint32_t>(ids) + table[i + 1]};
+        }
+
+        // Position of the first string >= key in a sorted string table.
+        uint32_t lower_bound_in(uint64_t offsets, uint64_t chars, uint32_t count, std::string_view key) const
+        {
+            uint32_t lo = 0, hi = count;
+            while (lo < hi)
+            {
+                uint32_t mid = lo + (hi - lo) / 2;
+                if (string_at(offsets, chars, mid) < key)
+                {
+                    lo = mid + 1;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+            return lo;
+        }
+
+        std::optional<uint32_t> find_in(uint64_t offsets, uint64_t chars, uint32_t count, std::string_view key) const
+        {
+            uint32_t lo = lower_bound_in(offsets, chars, count, key);
+            if (lo < count && string_at(offsets, chars, lo) == key) return lo;
+            return std::nullopt;
+        }
+
+    public:
+        explicit Reader(const std::string& path, Check check = Check::Header) : file(path), header{}
+        {
+            if (file.size() >= sizeof(Header))
+            {
+                std::memcpy(&header, file.data(), sizeof(Header));
+            }
+            validate(check);
+        }
+
+        uint32_t book_count() const { return header.book_count; }
+
+        uint32_t word_count() const { return header.word_count; }
+
+        std::string_view title(uint32_t book) const
+        {
+            return string_at(header.title_offsets, header.title_chars, book);
+        }
+
+        std::string_view word(uint32_t id) const
+        {
+            return string_at(header.word_offsets, header.word_chars, id);
+        }
+
+        std::optional<uint32_t> find_title(std::string_view title) const
+        {
+            return find_in(header.title_offsets, header.title_chars, header.book_count, title);
+        }
+
+        std::optional<uint32_t> find_word(std::string_view word) const
+        {
+            return find_in(header.word_offsets, header.word_chars, header.word_count, word);
+        }
+
+        // ID of the first word >= key; word_count() if there is none.
+        uint32_t lower_bound_word(std::string_view key) const
+        {
+            return lower_bound_in(header.word_offsets, header.word_chars, header.word_count, key);
+        }
+
+        IdRange book_words(uint32_t book) const
+        {
+            return range_at(header.book_offsets, header.book_words, book);
+        }
+
+        IdRange postings(uint32_t id) const
+        {
+            return range_at(header.posting_offsets, header.postings, id);
+        }
+
+        // Sum of book_words(book).size() over all books.
+        uint64_t total_book_words() const
+        {
+            return at<uint64_t>(header.book_offsets)[header.book_count];
+        }
+    };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef STRING_POOL_HPP
+#define STRING_POOL_HPP
+
+#include <vector>
+#include <string_view>
+#include <memory>
+#include <optional>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include "fast_hash.hpp"
+
+// Append-only set of distinct strings. Each string is copied once into a
+// shared arena and numbered with a dense 32-bit ID. Strings are never moved
+// or freed before the pool is destroyed, so tables may key on the views the
+// pool hands out instead of owning copies.
+class StringPool {
+public:
+    static constexpr size_t CHUNK_SIZE = 1 << 16;
+
+    StringPool() = default;
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+    StringPool(StringPool&&) = default;
+    StringPool& operator=(StringPool&&) = default;
+
+    uint32_t intern(std::string_view s) {
+        auto it = ids.find(s);
+        if (it != ids.end()) return it->second;
+        std::string_view stored = copy(s);
+        uint32_t id = static_cast<uint32_t>(strings.size());
+        strings.push_back(stored);
+        ids.emplace(stored, id);
+        return id;
+    }
+
+    std::optional<uint32_t> find(std::string_view s) const {
+        auto it = ids.find(s);
+        return it == ids.end() ? std::nullopt : std::optional<uint32_t>(it->second);
+    }
+
+    std::string_view view(uint32_t id) const {
+        return strings[id];
+    }
+
+    size_t size() const {
+        return strings.size();
+    }
+
+private:
+    std::vector<std::unique_ptr<char[]>> chunks;
+    char* head = nullptr;
+    size_t left = 0;
+    std::vector<std::string_view> strings;
+    std::unordered_map<std::string_view, uint32_t, FastHash::Hasher> ids;
+
+    // Strings longer than a quarter chunk get a block of their own so they
+    // do not waste the rest of the current chunk.
+    std::string_view copy(std::string_view s) {
+        char* at;
+        if (s.size() > CHUNK_SIZE / 4) {
+            chunks.push_back(std::make_unique<char[]>(s.size()));
+            at = chunks.back().get();
+        } else {
+            if (head == nullptr || s.size() > left) {
+                chunks.push_back(std::make_unique<char[]>(CHUNK_SIZE));
+                head = chunks.back().get();
+                left = CHUNK_SIZE;
+            }
+            at = head;
+            head += s.size();
+            left -= s.size();
+        }
+        std::memcpy(at, s.data(), s.size());
+        return std::string_view(at, s.size());
+    }
+};
+
+#endif
\ No newline at end of file
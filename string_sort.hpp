@@ -0,0 +1,110 @@
+#ifndef STRING_SORT_HPP
+#define STRING_SORT_HPP
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+
+// In-place multikey quicksort (three-way radix quicksort) for strings. Each
+// partition step looks at a single character, so shared prefixes are
+// compared once rather than at every level, and items are only ever
+// swapped, so sorting allocates nothing. key(item) gives the string an item
+// is sorted by, as a std::string or a std::string_view; the order of items
+// with equal keys is unspecified.
+namespace StringSort
+{
+    constexpr size_t INSERTION_CUTOFF = 16;
+
+    inline int char_at(std::string_view s, size_t depth)
+    {
+        return depth < s.size() ? static_cast<unsigned char>(s[depth]) : -1;
+    }
+
+    inline int median(int a, int b, int c)
+    {
+        return std::max(std::min(a, b), std::min(std::max(a, b), c));
+    }
+
+    // Every key in items[0, n) starts with the same `depth` characters.
+    template <typename T, typename Key>
+    void insertion_sort(T* items, size_t n, size_t depth, Key& key)
+    {
+        for (size_t i = 1; i < n; ++i)
+        {
+            for (size_t j = i; j > 0; --j)
+            {
+                std::string_view a = key(items[j]);
+                std::string_view b = key(items[j - 1]);
+                if (a.substr(depth).compare(b.substr(depth)) >= 0) break;
+                std::swap(items[j], items[j - 1]);
+            }
+        }
+    }
+
+    template <typename T, typename Key>
+    void multikey_quicksort(T* items, size_t n, size_t depth, Key& key)
+    {
+        while (n > INSERTION_CUTOFF)
+        {
+            int pivot = median(char_at(key(items[0]), depth), char_at(key(items[n / 2]), depth),
+                               char_at(key(items[n - 1]), depth));
+            size_t lt = 0, i = 0, gt = n;
+            while (i < gt)
+            {
+                int c = char_at(key(items[i]), depth);
+                if (c < pivot)
+                {
+                    std::swap(items[lt++], items[i++]);
+                }
+                else if (c > pivot)
+                {
+                    std::swap(items[i], items[--gt]);
+                }
+                else
+                {
+                    ++i;
+                }
+            }
+            multikey_quicksort(items, lt, depth, key);
+            multikey_quicksort(items + gt, n - gt, depth, key);
+            // Keys in the middle ended at depth: they are all equal.
+            if (pivot < 0) return;
+            items += lt;
+            n = gt - lt;
+            ++depth;
+        }
+        insertion_sort(items, n, depth, key);
+    }
+
+    template <typename T, typename Key>
+    void sort(std::vector<T>& items, Key key)
+    {
+        if (!items.empty())
+        {
+            multikey_quicksort(items.data(), items.size(), 0, key);
+        }
+    }
+
+    inline void sort(std::vector<std::string>& items)
+    {
+        sort(items, [](const std::string& s) -> const std::string& { return s; });
+    }
+
+    // Views are sorted by the text they point to.
+    inline void sort(std::vector<std::string_view>& items)
+    {
+        sort(items, [](std::string_view s) { return s; });
+    }
+
+    // Sorts and drops repeated strings in place.
+    inline void sort_unique(std::vector<std::string>& items)
+    {
+        sort(items);
+        items.erase(std::unique(items.begin(), items.end()), items.end());
+    }
+}
+
+#endif
\ No newline at end of file
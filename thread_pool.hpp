@@ -0,0 +1,189 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <algorithm>
+
+// Fixed set of workers with one task deque each. A worker takes tasks from
+// the back of its own deque and, once that is empty, steals from the front
+// of the others', so a few long books do not leave the other threads idle.
+// With a single thread no workers are started and everything runs inline.
+class ThreadPool {
+public:
+    static int default_threads() {
+        return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+
+    // Words below which starting threads costs more than it saves.
+    static constexpr size_t MIN_PARALLEL_WORDS = 1 << 14;
+
+    // Threads worth starting for `tasks` tasks of `words` words in total
+    // when `threads` were asked for (0: one per hardware thread): 1, which
+    // runs everything inline, for small inputs, and never more than tasks.
+    static int threads_for(size_t tasks, size_t words, int threads) {
+        if (tasks <= 1 || words < MIN_PARALLEL_WORDS) return 1;
+        int count = threads > 0 ? threads : default_threads();
+        return static_cast<int>(std::min<size_t>(count, tasks));
+    }
+
+    // threads <= 0 means one per hardware thread.
+    explicit ThreadPool(int threads = 0) : stopping(false), queued(0) {
+        int count = threads > 0 ? threads : default_threads();
+        if (count == 1) return;
+        for (int w = 0; w < count; ++w) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (int w = 0; w < count; ++w) {
+            workers.emplace_back([this, w]() { work(w); });
+            ++running();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard(wake_lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+            --running();
+        }
+    }
+
+    // Worker threads of every pool in the process not yet joined.
+    static int live_threads() {
+        return running().load();
+    }
+
+    int size() const {
+        return std::max(1, static_cast<int>(workers.size()));
+    }
+
+    // Calls f(i) for every i in [0, n) and returns once all calls are done.
+    // Indices are cut into blocks dealt round-robin over the deques. The
+    // first exception thrown by f is rethrown here.
+    template <typename F>
+    void parallel_for(size_t n, F&& f) {
+        if (workers.empty() || n <= 1) {
+            for (size_t i = 0; i < n; ++i) f(i);
+            return;
+        }
+        size_t grain = std::max<size_t>(1, n / (workers.size() * 8));
+        size_t blocks = (n + grain - 1) / grain;
+
+        // Lives on this frame. left only changes under lock, and the last
+        // block notifies before releasing it, so the waiter cannot see zero
+        // and destroy batch while a worker still touches it.
+        struct Batch {
+            size_t left;
+            std::mutex lock;
+            std::condition_variable done;
+            std::exception_ptr error;
+        } batch;
+        batch.left = blocks;
+
+        for (size_t b = 0; b < blocks; ++b) {
+            size_t begin = b * grain;
+            size_t end = std::min(n, begin + grain);
+            push(b % queues.size(), [&f, &batch, begin, end]() {
+                std::exception_ptr error;
+                try {
+                    for (size_t i = begin; i < end; ++i) f(i);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                std::lock_guard<std::mutex> guard(batch.lock);
+                if (error && !batch.error) batch.error = error;
+                if (--batch.left == 0) batch.done.notify_one();
+            });
+        }
+
+        std::unique_lock<std::mutex> guard(batch.lock);
+        batch.done.wait(guard, [&]() { return batch.left == 0; });
+        if (batch.error) std::rethrow_exception(batch.error);
+    }
+
+private:
+    using Task = std::function<void()>;
+
+    struct Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex wake_lock;
+    std::condition_variable wake;
+    bool stopping;
+    std::atomic<size_t> queued;
+
+    static std::atomic<int>& running() {
+        static std::atomic<int> count(0);
+        return count;
+    }
+
+    // queued changes under the lock of the deque holding the task, so it
+    // never drops below zero; taking wake_lock before notifying makes sure a
+    // worker that just saw zero is already waiting.
+    void push(size_t w, Task task) {
+        {
+            std::lock_guard<std::mutex> guard(queues[w]->lock);
+            queues[w]->tasks.push_back(std::move(task));
+            ++queued;
+        }
+        {
+            std::lock_guard<std::mutex> guard(wake_lock);
+        }
+        wake.notify_one();
+    }
+
+    bool pop(size_t w, Task& task) {
+        std::lock_guard<std::mutex> guard(queues[w]->lock);
+        if (queues[w]->tasks.empty()) return false;
+        task = std::move(queues[w]->tasks.back());
+        queues[w]->tasks.pop_back();
+        --queued;
+        return true;
+    }
+
+    bool steal(size_t w, Task& task) {
+        for (size_t k = 1; k < queues.size(); ++k) {
+            Queue& victim = *queues[(w + k) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (victim.tasks.empty()) continue;
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --queued;
+            return true;
+        }
+        return false;
+    }
+
+    void work(size_t w) {
+        Task task;
+        while (true) {
+            if (pop(w, task) || steal(w, task)) {
+                task();
+                continue;
+            }
+            std::unique_lock<std::mutex> guard(wake_lock);
+            wake.wait(guard, [&]() { return stopping || queued.load() > 0; });
+            if (stopping && queued.load() == 0) return;
+        }
+    }
+};
+
+#endif
\ No newline at end of file
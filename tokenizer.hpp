@@ -0,0 +1,158 @@
+#ifndef TOKENIZER_HPP
+#define TOKENIZER_HPP
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Splits text into words separated by delimiters: space and the ASCII
+// control characters (every byte <= ' '). Tokens are reported as views into
+// the input, so tokenizing allocates nothing.
+namespace Tokenizer
+{
+    constexpr size_t BLOCK = 16;
+
+    inline bool is_delimiter(char c)
+    {
+        return static_cast<unsigned char>(c) <= ' ';
+    }
+
+    // Bit i is set when p[i] is a delimiter.
+    inline uint32_t delimiter_mask(const char* p)
+    {
+#if defined(__SSE2__)
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i space = _mm_set1_epi8(' ');
+        // Unsigned b <= ' ' exactly when max(b, ' ') == ' '.
+        __m128i low = _mm_cmpeq_epi8(_mm_max_epu8(bytes, space), space);
+        return static_cast<uint32_t>(_mm_movemask_epi8(low));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < BLOCK; ++i)
+        {
+            if (is_delimiter(p[i])) mask |= 1u << i;
+        }
+        return mask;
+#endif
+    }
+
+    inline int lowest(uint32_t mask)
+    {
+#if defined(__GNUC__)
+        return __builtin_ctz(mask);
+#else
+        int i = 0;
+        while (!(mask & 1u))
+        {
+            mask >>= 1;
+            ++i;
+        }
+        return i;
+#endif
+    }
+
+    // Calls f for every token that ends inside text and returns the length
+    // of the unfinished token running up to its end (0 if text ends in a
+    // delimiter). Sixteen bytes are classified at a time; the loop only
+    // stops at token boundaries.
+    template <typename F>
+    size_t scan(std::string_view text, F& f)
+    {
+        const char* p = text.data();
+        size_t n = text.size();
+        size_t start = 0;
+        bool in_token = false;
+        size_t i = 0;
+        for (; i + BLOCK <= n; i += BLOCK)
+        {
+            uint32_t delimiters = delimiter_mask(p + i);
+            uint32_t live = (1u << BLOCK) - 1;
+            while (true)
+            {
+                uint32_t edges = (in_token ? delimiters : ~delimiters) & live;
+                if (edges == 0) break;
+                int bit = lowest(edges);
+                if (in_token)
+                {
+                    f(std::string_view(p + start, i + bit - start));
+                }
+                else
+                {
+                    start = i + bit;
+                }
+                in_token = !in_token;
+                live &= ~((2u << bit) - 1);
+            }
+        }
+        for (; i < n; ++i)
+        {
+            if (is_delimiter(p[i]) == in_token)
+            {
+                if (in_token)
+                {
+                    f(std::string_view(p + start, i - start));
+                }
+                else
+                {
+                    start = i;
+                }
+                in_token = !in_token;
+            }
+        }
+        return in_token ? n - start : 0;
+    }
+
+    template <typename F>
+    void for_each_token(std::string_view text, F&& f)
+    {
+        size_t tail = scan(text, f);
+        if (tail > 0) f(text.substr(text.size() - tail));
+    }
+
+    // Tokenizes text that arrives in consecutive pieces. A token cut by a
+    // piece boundary is copied into a buffer and reported once it is whole;
+    // every other token is a view into its piece, valid during the call.
+    template <typename F>
+    class Stream
+    {
+    private:
+        F f;
+        std::string carry;
+
+    public:
+        explicit Stream(F f_) : f(std::forward<F>(f_)) {}
+
+        void feed(std::string_view piece)
+        {
+            if (!carry.empty())
+            {
+                size_t end = 0;
+                while (end < piece.size() && !is_delimiter(piece[end])) ++end;
+                carry.append(piece.data(), end);
+                if (end == piece.size()) return;
+                f(std::string_view(carry));
+                carry.clear();
+                piece.remove_prefix(end);
+            }
+            size_t tail = scan(piece, f);
+            carry.assign(piece.data() + piece.size() - tail, tail);
+        }
+
+        void finish()
+        {
+            if (!carry.empty())
+            {
+                f(std::string_view(carry));
+                carry.clear();
+            }
+        }
+    };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,257 @@
+#ifndef WORKER_PROCESS_HPP
+#define WORKER_PROCESS_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+#include "thread_pool.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define WORKER_PROCESS_FORK 1
+#if defined(__linux__)
+#include <dirent.h>
+#endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+// Buffered message stream over one end of a Unix socket pair. put_* calls
+// append to the outgoing message and send() writes it; get_* calls block
+// until their bytes arrive. Integers travel little-endian as the host
+// stores them, since both ends are the same binary on the same machine.
+class Channel {
+public:
+    explicit Channel(int fd_) : fd(fd_) {}
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    ~Channel() {
+#if defined(WORKER_PROCESS_FORK)
+        if (fd >= 0) ::close(fd);
+#endif
+    }
+
+    void put_u64(uint64_t value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void put_double(double value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void put_string(std::string_view value) {
+        put_u64(value.size());
+        out.append(value);
+    }
+
+    template <typename Strings>
+    void put_strings(const Strings& values) {
+        put_u64(values.size());
+        for (const auto& value : values) {
+            put_string(value);
+        }
+    }
+
+    void send() {
+#if defined(WORKER_PROCESS_FORK)
+        size_t sent = 0;
+        while (sent < out.size()) {
+            ssize_t n = ::send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                throw std::invalid_argument("Worker connection closed");
+            }
+            sent += static_cast<size_t>(n);
+        }
+#endif
+        out.clear();
+    }
+
+    uint64_t get_u64() {
+        uint64_t value;
+        read(&value, sizeof(value));
+        return value;
+    }
+
+    double get_double() {
+        double value;
+        read(&value, sizeof(value));
+        return value;
+    }
+
+    std::string get_string() {
+        std::string value(get_u64(), '\0');
+        read(value.data(), value.size());
+        return value;
+    }
+
+    std::vector<std::string> get_strings() {
+        std::vector<std::string> values(get_u64());
+        for (auto& value : values) {
+            value = get_string();
+        }
+        return values;
+    }
+
+    // Whether the other end closed the connection with nothing left unread.
+    bool at_end() {
+        return in_pos == in.size() && !fill();
+    }
+
+private:
+    int fd;
+    std::string out;
+    std::string in;
+    size_t in_pos = 0;
+
+    bool fill() {
+#if defined(WORKER_PROCESS_FORK)
+        char buffer[1 << 16];
+        ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) return false;
+        in.erase(0, in_pos);
+        in_pos = 0;
+        in.append(buffer, static_cast<size_t>(n));
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void read(void* target, size_t length) {
+        char* to = static_cast<char*>(target);
+        while (length > 0) {
+            if (in_pos == in.size() && !fill()) {
+                throw std::invalid_argument("Worker connection closed");
+            }
+            size_t n = std::min(length, in.size() - in_pos);
+            std::memcpy(to, in.data() + in_pos, n);
+            in_pos += n;
+            to += n;
+            length -= n;
+        }
+    }
+};
+
+// A forked child that runs serve() on its end of a socket pair and exits
+// when serve() returns; the parent talks to it through channel(). The
+// child closes the parent ends of every other live worker, so each worker
+// sees end of stream as soon as its own parent end is closed.
+//
+// fork() copies only the calling thread, so a lock another thread held at
+// that moment, in malloc, a pool's deques or a stream, would stay locked
+// in the child for good. Workers are therefore only forked while the
+// process runs no other thread: every worker must be started before the
+// first pool or thread, and the constructor throws otherwise.
+// Linux counts the threads in /proc/self/task; elsewhere only ThreadPool
+// threads are seen. exec'ing a fresh binary instead would be safe at any
+// time, but could not run the library factory the caller passes in.
+class WorkerProcess {
+public:
+    explicit WorkerProcess(const std::function<void(Channel&)>& serve) {
+#if defined(WORKER_PROCESS_FORK)
+        if (other_threads()) {
+            throw std::invalid_argument("Worker processes must start before any other thread");
+        }
+        int ends[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, ends) != 0) {
+            throw std::invalid_argument("Cannot create worker socket");
+        }
+        std::lock_guard<std::mutex> guard(registry_lock());
+        pid = ::fork();
+        if (pid < 0) {
+            ::close(ends[0]);
+            ::close(ends[1]);
+            throw std::invalid_argument("Cannot start worker process");
+        }
+        if (pid == 0) {
+            ::close(ends[0]);
+            for (int fd : parent_ends()) {
+                ::close(fd);
+            }
+            int status = 0;
+            try {
+                Channel channel(ends[1]);
+                serve(channel);
+            } catch (...) {
+                status = 1;
+            }
+            ::_exit(status);
+        }
+        ::close(ends[1]);
+        parent_ends().push_back(ends[0]);
+        link = std::make_unique<Channel>(ends[0]);
+        fd = ends[0];
+#else
+        (void)serve;
+        throw std::invalid_argument("Worker processes need a POSIX system");
+#endif
+    }
+
+    WorkerProcess(const WorkerProcess&) = delete;
+    WorkerProcess& operator=(const WorkerProcess&) = delete;
+
+    // Closes the connection and waits for the worker to exit.
+    ~WorkerProcess() {
+#if defined(WORKER_PROCESS_FORK)
+        {
+            std::lock_guard<std::mutex> guard(registry_lock());
+            auto& ends = parent_ends();
+            ends.erase(std::remove(ends.begin(), ends.end(), fd), ends.end());
+            link.reset();
+        }
+        int status;
+        ::waitpid(pid, &status, 0);
+#endif
+    }
+
+    Channel& channel() {
+        return *link;
+    }
+
+private:
+    std::unique_ptr<Channel> link;
+    int fd = -1;
+#if defined(WORKER_PROCESS_FORK)
+    pid_t pid = -1;
+#endif
+
+    // Whether any thread besides the caller is running.
+    static bool other_threads() {
+#if defined(__linux__)
+        if (DIR* tasks = ::opendir("/proc/self/task")) {
+            int count = 0;
+            while (const dirent* entry = ::readdir(tasks)) {
+                if (entry->d_name[0] != '.') ++count;
+            }
+            ::closedir(tasks);
+            return count > 1;
+        }
+#endif
+        return ThreadPool::live_threads() > 0;
+    }
+
+    static std::mutex& registry_lock() {
+        static std::mutex lock;
+        return lock;
+    }
+
+    static std::vector<int>& parent_ends() {
+        static std::vector<int> ends;
+        return ends;
+    }
+};
+
+#endif
\ No newline at end of file